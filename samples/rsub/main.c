@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+int rsub(int a);
+int rsub_ref(int a);
+
+int main()
+{
+    for (int a = -3; a <= 3; ++a)
+    {
+        printf("%d ", rsub(a));
+    }
+
+    printf("\n");
+
+    for (int a = -3; a <= 3; ++a)
+    {
+        printf("%d ", rsub_ref(a));
+    }
+
+    printf("\n");
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ucb
+{
+    // bump allocator, memory is only given back all at once by reset or when
+    // the arena is destroyed. objects created with make() that are not
+    // trivially destructible get their destructors run at that point too
+    class Arena
+    {
+    public:
+        static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+        Arena() = default;
+        Arena(const Arena&) = delete;
+        Arena& operator = (const Arena&) = delete;
+
+        ~Arena()
+        {
+            _run_dtors();
+        }
+
+        void* allocate(std::size_t size, std::size_t align)
+        {
+            auto p = (_cursor + align - 1) & ~(static_cast<std::uintptr_t>(align) - 1);
+
+            if (p + size > _end)
+            {
+                _new_chunk(size + align);
+                p = (_cursor + align - 1) & ~(static_cast<std::uintptr_t>(align) - 1);
+            }
+
+            _cursor = p + size;
+            return reinterpret_cast<void*>(p);
+        }
+
+        template<typename T, typename ...ARGS>
+        T* make(ARGS&&... args)
+        {
+            if constexpr (std::is_trivially_destructible_v<T>)
+            {
+                auto mem = allocate(sizeof(T), alignof(T));
+                return new (mem) T(std::forward<ARGS>(args)...);
+            }
+            else
+            {
+                // keep a record so reset() can destroy the object later
+                auto rec = static_cast<DtorRecord*>(allocate(sizeof(DtorRecord), alignof(DtorRecord)));
+                auto mem = allocate(sizeof(T), alignof(T));
+                auto obj = new (mem) T(std::forward<ARGS>(args)...);
+
+                rec->obj = obj;
+                rec->dtor = [](void *p) { static_cast<T*>(p)->~T(); };
+                rec->next = _dtors;
+                _dtors = rec;
+
+                return obj;
+            }
+        }
+
+        // releases everything allocated so far but keeps the first chunk
+        // around so the next round of allocations does not hit the heap
+        void reset()
+        {
+            _run_dtors();
+
+            if (_chunks.empty())
+            {
+                return;
+            }
+
+            _chunks.resize(1);
+            _cursor = reinterpret_cast<std::uintptr_t>(_chunks.front().first.get());
+            _end = _cursor + _chunks.front().second;
+        }
+
+        std::size_t allocated_bytes() const
+        {
+            std::size_t res = 0;
+
+            for (auto& [ptr, size]: _chunks)
+            {
+                res += size;
+            }
+
+            return res;
+        }
+
+    private:
+        struct DtorRecord
+        {
+            void *obj;
+            void (*dtor)(void*);
+            DtorRecord *next;
+        };
+
+        std::vector<std::pair<std::unique_ptr<std::byte[]>, std::size_t>> _chunks;
+        std::uintptr_t _cursor{0};
+        std::uintptr_t _end{0};
+        DtorRecord *_dtors{nullptr};
+
+        void _new_chunk(std::size_t min_size)
+        {
+            auto size = min_size > CHUNK_SIZE ? min_size : CHUNK_SIZE;
+            _chunks.emplace_back(std::unique_ptr<std::byte[]>(new std::byte[size]), size);
+            _cursor = reinterpret_cast<std::uintptr_t>(_chunks.back().first.get());
+            _end = _cursor + size;
+        }
+
+        void _run_dtors()
+        {
+            while (_dtors != nullptr)
+            {
+                auto rec = _dtors;
+                _dtors = rec->next;
+                rec->dtor(rec->obj);
+            }
+        }
+    };
+
+    // std allocator adaptor so standard containers can draw from an arena,
+    // deallocation is a no-op since the arena frees everything at once
+    template<typename T>
+    class ArenaAllocator
+    {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        ArenaAllocator(Arena *arena):
+            _arena{arena}
+        {
+            assert(_arena);
+        }
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other):
+            _arena{other.arena()}
+        {
+        }
+
+        T* allocate(std::size_t n)
+        {
+            return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T*, std::size_t)
+        {
+        }
+
+        Arena* arena() const { return _arena; }
+
+        template<typename U>
+        bool operator == (const ArenaAllocator<U>& other) const
+        {
+            return _arena == other.arena();
+        }
+
+    private:
+        Arena *_arena;
+    };
+}
@@ -1,8 +1,12 @@
 #include <ucb/core/backend/x64.hpp>
 
+#include <algorithm>
+#include <numeric>
 #include <set>
 #include <unordered_map>
 
+#include <ucb/core/isel/pat-table.hpp>
+
 namespace ucb::x64
 {
     static const std::unordered_map<MachineOpc, std::string> OPCS = {{
@@ -216,6 +220,7 @@ namespace ucb::x64
 #define REP_MOVE_RM(...) REP_NODE(T_SAME, OPC_MOVE_RM, __VA_ARGS__)
 #define REP_MOVE_MR(...) REP_NODE(T_SAME, OPC_MOVE_MR, __VA_ARGS__)
 #define REP_MOVE_RR(...) REP_NODE(T_SAME, OPC_MOVE_RR, __VA_ARGS__)
+#define REP_MOVE_RI(...) REP_NODE(T_SAME, OPC_MOVE_RI, __VA_ARGS__)
 #define REP_RET(...)     REP_NODE(T_SAME, OPC_RET,     __VA_ARGS__)
 #define REP_ADD(...)     BIN_NODE(T_SAME, OPC_ADD,     __VA_ARGS__)
 #define REP_SUB(...)     BIN_NODE(T_SAME, OPC_SUB,     __VA_ARGS__)
@@ -276,6 +281,20 @@ namespace ucb::x64
         .reps = { REP_MOVE_RM(-1, 0) }      \
     }
 
+#define CP_RR_PAT(COST, TY)                             \
+    {                                                   \
+        .cost = COST,                                   \
+        .pat = INST_PAT_NODE(TY, OP_CP, PAT_REG_OPND),  \
+        .reps = { REP_MOVE_RR(-1, 0) }                  \
+    }
+
+#define CP_RI_PAT(COST, TY)                                 \
+    {                                                       \
+        .cost = COST,                                       \
+        .pat = INST_PAT_NODE(TY, OP_CP, PAT_IMM_INT_OPND),  \
+        .reps = { REP_MOVE_RI(-1, 0) }                      \
+    }
+
 #define STORE_PAT(COST, TY)                             \
     {                                                   \
         .cost = COST,                                   \
@@ -342,7 +361,7 @@ namespace ucb::x64
     {                                                               \
         .cost = COST,                                               \
         .pat = SUB_PAT_NODE(TY, PAT_IMM_INT_OPND, PAT_REG_OPND),    \
-        .reps = { REP_MOVE_RR(-1, 1), REP_SUB(-1, 0) }              \
+        .reps = { REP_MOVE_RI(-1, 0), REP_SUB(-1, 1) }              \
     }
 
 #define MUL_RR_PAT(COST, TY)                                    \
@@ -983,9 +1002,11 @@ namespace ucb::x64
         .reps = { REP_CALL(T_SAME) }    \
     }
 
-    std::vector<Pat> X64Target::load_pats()
+    // the patterns are only written down here, PatTable turns them into
+    // read only arrays while compiling so load_pats has nothing to build
+    static constexpr std::vector<PatSpec> x64_pats()
     {
-        return std::initializer_list<Pat>
+        return
         {
             // single load signed int from frame slot
             LOAD_PAT(1, T_ANY_I),
@@ -995,6 +1016,12 @@ namespace ucb::x64
             STORE_PAT(1, T_ANY_I),
             // single store unsigned int to frame slot
             STORE_PAT(1, T_ANY_U),
+            // copy between registers, also what ISel wraps immediates in
+            // when no pattern takes them as they are
+            CP_RR_PAT(1, T_ANY_I),
+            CP_RR_PAT(1, T_ANY_U),
+            CP_RI_PAT(1, T_ANY_I),
+            CP_RI_PAT(1, T_ANY_U),
             // add 2 signed integer registers
             ADD_RR_PAT(1, T_ANY_I),
             // add 2 unsigned integer registers
@@ -1137,9 +1164,20 @@ namespace ucb::x64
         };
     }
 
-    std::vector<RegisterClass> X64Target::load_reg_classes()
+    using X64PatTable = PatTable<x64_pats>;
+
+    static_assert(X64PatTable::first_unreachable() == -1, "x64 pattern can never be selected");
+
+    std::span<const Pat> X64Target::load_pats()
+    {
+        return X64PatTable::pats();
+    }
+
+    // built on first use, function local statics are initialized once even
+    // when several workers get here at the same time
+    const std::vector<RegisterClass>& X64Target::load_reg_classes()
     {
-        return std::initializer_list<RegisterClass>
+        static const std::vector<RegisterClass> REG_CLASSES =
         {
             // GPR
             {
@@ -1147,6 +1185,8 @@ namespace ucb::x64
                 .tys = {T_ANY_I, T_ANY_U}
             }
         };
+
+        return REG_CLASSES;
     }
 
     bool X64Target::is_rr_move(MachineOpc opc)
@@ -1154,10 +1194,52 @@ namespace ucb::x64
         return opc == OPC_MOVE_RR;
     }
 
+    MachineInstruction X64Target::load_from_slot(RegisterID reg, TypeID ty, std::uint64_t slot)
+    {
+        MachineInstruction inst(OPC_MOVE_RM);
+        inst.size = ty.size;
+
+        inst.opnds.push_back({
+            .kind = MachineOperand::Register,
+            .ty = ty,
+            .val = std::bit_cast<std::uint64_t>(reg),
+            .is_def = true,
+            .is_use = false
+        });
+
+        inst.opnds.push_back({
+            .kind = MachineOperand::FrameSlot,
+            .ty = ty,
+            .val = slot
+        });
+
+        return inst;
+    }
+
+    MachineInstruction X64Target::store_to_slot(RegisterID reg, TypeID ty, std::uint64_t slot)
+    {
+        MachineInstruction inst(OPC_MOVE_MR);
+        inst.size = ty.size;
+
+        inst.opnds.push_back({
+            .kind = MachineOperand::FrameSlot,
+            .ty = ty,
+            .val = slot
+        });
+
+        inst.opnds.push_back({
+            .kind = MachineOperand::Register,
+            .ty = ty,
+            .val = std::bit_cast<std::uint64_t>(reg)
+        });
+
+        return inst;
+    }
+
     void X64Target::dump_proc(Procedure& proc, std::ostream& out)
     {
         proc.context()->dump_ty(out, proc.signature().ret());
-        out << " @" << proc.id();
+        out << " @" << proc.name();
 
         out << "\n{\n";
 
@@ -1171,7 +1253,8 @@ namespace ucb::x64
 
     void X64Target::dump_bblock(BasicBlock& bblock, std::ostream& out)
     {
-        out << bblock.id() << ":\n";
+        out << bblock.name() << ":\n";
+        out << "\tloop depth: " << bblock.loop_depth() << ", frequency: " << bblock.frequency() << "\n\n";
 
         if (!bblock.predecessors().empty())
         {
@@ -1179,7 +1262,7 @@ namespace ucb::x64
 
             for (auto pred: bblock.predecessors())
             {
-                out << "\t\t" << pred->id() << "\n";
+                out << "\t\t" << pred->name() << "\n";
             }
 
             out << "\n";
@@ -1564,7 +1647,7 @@ namespace ucb::x64
             // otherwise, add stackdown on new basic block
             else if (rets.size() > 0)
             {
-                exit_id = proc.add_bblock("exit");
+                exit_id = proc.add_bblock(proc.context()->symbols().intern("exit"));
 
                 for (auto id: rets)
                 {
@@ -1614,33 +1697,37 @@ namespace ucb::x64
                 exit.machine_insts().insert(stackdown_insertpoint, std::move(inst));
             }
 
-            // restore rsp
-            MachineInstruction restore_rsp;
-            restore_rsp.opc = OPC_ADD;
-            restore_rsp.size = RSP.size;
-            auto ty = T_ANY_I;
-            ty.size = RSP.size;
-            restore_rsp.opnds.push_back({
-                .kind = MachineOperand::Register,
-                .ty = ty,
-                .val = std::bit_cast<std::uint64_t>(RSP)
-            });
-            restore_rsp.opnds.push_back({
-                .kind = MachineOperand::Imm,
-                .ty = ty,
-                .val = static_cast<std::uint64_t>(stack_size)
-            });
-            exit.machine_insts().insert(stackdown_insertpoint, std::move(restore_rsp));
+            // only a procedure with a frame saved rbp
+            if (stack_size > 0)
+            {
+                // restore rsp
+                MachineInstruction restore_rsp;
+                restore_rsp.opc = OPC_ADD;
+                restore_rsp.size = RSP.size;
+                auto ty = T_ANY_I;
+                ty.size = RSP.size;
+                restore_rsp.opnds.push_back({
+                    .kind = MachineOperand::Register,
+                    .ty = ty,
+                    .val = std::bit_cast<std::uint64_t>(RSP)
+                });
+                restore_rsp.opnds.push_back({
+                    .kind = MachineOperand::Imm,
+                    .ty = ty,
+                    .val = static_cast<std::uint64_t>(stack_size)
+                });
+                exit.machine_insts().insert(stackdown_insertpoint, std::move(restore_rsp));
 
-            // restore rsp
-            MachineInstruction restore_rbp;
-            restore_rbp.opc = OPC_POP;
-            restore_rbp.size = RBP.size;
-            restore_rbp.opnds.push_back({
-                .kind = MachineOperand::Register,
-                .val = std::bit_cast<std::uint64_t>(RBP)
-            });
-            exit.machine_insts().insert(stackdown_insertpoint, std::move(restore_rbp));
+                // restore rbp
+                MachineInstruction restore_rbp;
+                restore_rbp.opc = OPC_POP;
+                restore_rbp.size = RBP.size;
+                restore_rbp.opnds.push_back({
+                    .kind = MachineOperand::Register,
+                    .val = std::bit_cast<std::uint64_t>(RBP)
+                });
+                exit.machine_insts().insert(stackdown_insertpoint, std::move(restore_rbp));
+            }
         }
 
         // for each function call add stackup & stackdown
@@ -1710,20 +1797,35 @@ namespace ucb::x64
 
                             auto reg = std::bit_cast<RegisterID>(opnd.val);
 
-                            if (opnd.is_def)
+                            if (opnd.is_def && !opnd.is_use)
                             {
                                 live_regs.erase(reg);
                             }
-                            else
+                        }
+
+                        for (auto& opnd: rev_it->opnds)
+                        {
+                            if (opnd.kind == MachineOperand::Register && (!opnd.is_def || opnd.is_use))
                             {
-                                live_regs.insert(reg);
+                                live_regs.insert(std::bit_cast<RegisterID>(opnd.val));
                             }
                         }
 
                         --rev_it;
                     }
 
-                    // preserve caller saved clobbers
+                    // the call writes its own defs, restoring them would
+                    // clobber the returned value
+                    for (auto& opnd: inst.opnds)
+                    {
+                        if (opnd.kind == MachineOperand::Register && opnd.is_def)
+                        {
+                            live_regs.erase(std::bit_cast<RegisterID>(opnd.val));
+                        }
+                    }
+
+                    // preserve caller saved clobbers, push and pop only take
+                    // whole registers
                     for (auto reg: live_regs)
                     {
                         if (!CALLER_SAVED_REGS.contains(reg))
@@ -1731,6 +1833,8 @@ namespace ucb::x64
                             continue;
                         }
 
+                        reg.size = 64;
+
                         // push register
                         MachineInstruction inst;
                         inst.opc = OPC_PUSH;
@@ -1752,7 +1856,8 @@ namespace ucb::x64
                         opnd.val = std::bit_cast<std::uint64_t>(reg);
                         inst.opnds.push_back(opnd);
 
-                        m_insts.insert(next_it, std::move(inst));
+                        // pops go in the reverse order of the pushes
+                        next_it = m_insts.insert(next_it, std::move(inst));
                     }
 
                     // put everything on the correct registers
@@ -1765,6 +1870,7 @@ namespace ucb::x64
                         if (opnd.is_def)
                         {
                             auto ret_reg = RETURN_REGISTERS[arg_idx++];
+                            ret_reg.size = opnd.ty.size;
 
                             //std::cout << "ret!!! " << ret_reg.val << std::endl;
 
@@ -1781,7 +1887,9 @@ namespace ucb::x64
                                 reg_opnd.val = std::bit_cast<std::uint64_t>(ret_reg);
                                 inst.opnds.push_back(reg_opnd);
 
-                                m_insts.insert(inst_it, inst);
+                                // read the returned value before the
+                                // saved registers are restored
+                                m_insts.insert(next_it, inst);
                             }
                         }
                         else
@@ -1831,132 +1939,267 @@ namespace ucb::x64
         }
     }
 
-    void X64Target::print_asm(CompileUnit& unit, std::ostream& out, const std::string& src_filename)
+    static const std::unordered_map<MachineOpc, MachineOpc> INVERTED_JCCS = {{
+        {OPC_JE, OPC_JNE}, {OPC_JNE, OPC_JE},
+        {OPC_JB, OPC_JNB}, {OPC_JNB, OPC_JB},
+        {OPC_JL, OPC_JNL}, {OPC_JNL, OPC_JL},
+        {OPC_JBE, OPC_JNBE}, {OPC_JNBE, OPC_JBE},
+        {OPC_JLE, OPC_JNLE}, {OPC_JNLE, OPC_JLE},
+        {OPC_JA, OPC_JNA}, {OPC_JNA, OPC_JA},
+        {OPC_JG, OPC_JNG}, {OPC_JNG, OPC_JG},
+        {OPC_JAE, OPC_JNAE}, {OPC_JNAE, OPC_JAE},
+        {OPC_JGE, OPC_JNGE}, {OPC_JNGE, OPC_JGE},
+    }};
+
+    // each block is followed by its hottest successor that is not placed
+    // yet, so loop bodies and the likely side of branches fall through.
+    // when there is none the hottest block left starts a new chain
+    static std::vector<std::size_t> block_layout(Procedure& proc)
+    {
+        auto& bblocks = proc.bblocks();
+        std::vector<std::size_t> res;
+        std::vector<bool> placed(bblocks.size(), false);
+        std::vector<std::size_t> by_frequency(bblocks.size());
+        std::size_t next = 0;
+        std::size_t cur = 0;
+
+        std::iota(by_frequency.begin(), by_frequency.end(), 0);
+        std::stable_sort(by_frequency.begin(), by_frequency.end(), [&](auto a, auto b)
+        {
+            return bblocks[a].frequency() > bblocks[b].frequency();
+        });
+
+        res.reserve(bblocks.size());
+
+        while (res.size() < bblocks.size())
+        {
+            placed[cur] = true;
+            res.push_back(cur);
+
+            // successors are read off the branches, the exit block made by
+            // stack_lower is not on the cfg
+            auto succ = bblocks.size();
+            auto best = -1.0f;
+
+            for (auto& inst: bblocks[cur].machine_insts())
+            {
+                for (auto& opnd: inst.opnds)
+                {
+                    if (opnd.kind != MachineOperand::BBlockAddress || placed[opnd.val]) { continue; }
+
+                    if (bblocks[opnd.val].frequency() > best)
+                    {
+                        succ = opnd.val;
+                        best = bblocks[opnd.val].frequency();
+                    }
+                }
+            }
+
+            if (succ == bblocks.size())
+            {
+                while (next < bblocks.size() && placed[by_frequency[next]])
+                {
+                    ++next;
+                }
+
+                // every block is placed
+                if (next == bblocks.size())
+                {
+                    break;
+                }
+
+                succ = by_frequency[next];
+            }
+
+            cur = succ;
+        }
+
+        return res;
+    }
+
+    // drops the jump at the end of bblock when it goes to the block laid
+    // out next, inverting a conditional jump right before it if needed
+    static void fall_through(BasicBlock& bblock, std::size_t next)
+    {
+        auto& insts = bblock.machine_insts();
+
+        auto is_jump_to = [](MachineInstruction& inst, std::size_t target)
+        {
+            return inst.opnds.size() == 1
+                && inst.opnds[0].kind == MachineOperand::BBlockAddress
+                && inst.opnds[0].val == target;
+        };
+
+        if (insts.empty() || insts.back().opc != OPC_JMP)
+        {
+            return;
+        }
+
+        auto jmp = --insts.end();
+
+        if (is_jump_to(*jmp, next))
+        {
+            insts.erase(jmp);
+            return;
+        }
+
+        if (jmp == insts.begin())
+        {
+            return;
+        }
+
+        auto jcc = std::prev(jmp);
+        auto inverted = INVERTED_JCCS.find(jcc->opc);
+
+        if (inverted != INVERTED_JCCS.end() && is_jump_to(*jcc, next))
+        {
+            jcc->opc = inverted->second;
+            jcc->opnds[0].val = jmp->opnds[0].val;
+            insts.erase(jmp);
+        }
+    }
+
+    void X64Target::begin_asm(std::ostream& out, const std::string& src_filename)
     {
         out
             << "\t.text\n"
             << "\t.intel_syntax noprefix\n"
             << "\t.file   \"" << src_filename << "\"\n";
 
-        int proc_cnt = 0;
-        int tmp_lbl_cnt = 0;
+        _asm_proc_cnt = 0;
+        _asm_lbl_cnt = 0;
+    }
 
-        for (auto proc_ptr: unit.procs())
-        {
-            auto& proc = *proc_ptr;
+    void X64Target::print_proc_asm(Procedure& proc, std::ostream& out)
+    {
+        out
+            << "\t.globl\t" << proc.name() << "\n"
+            << "\t.p2align\t4, 0x90\n"
+            << "\t.type\t" << proc.name() << ",@function\n"
+            << proc.name() << ":\n";
+
+        std::vector<std::string> tmp_lbl_names;
+        tmp_lbl_names.reserve(proc.bblocks().size());
 
-            //dump_proc(proc, std::cout);
+        for (auto& bblock: proc.bblocks())
+        {
+            std::string name = ".TmpLbl" + std::to_string(_asm_lbl_cnt++);
+            tmp_lbl_names.push_back(std::move(name));
+        }
 
-            out
-                << "\t.globl\t" << proc.id() << "\n"
-                << "\t.p2align\t4, 0x90\n"
-                << "\t.type\t" << proc.id() << ",@function\n"
-                << proc.id() << ":\n";
+        auto layout = block_layout(proc);
 
-            std::vector<std::string> tmp_lbl_names;
-            tmp_lbl_names.reserve(proc.bblocks().size());
+        for (std::size_t pos = 0; pos < layout.size(); ++pos)
+        {
+            auto i = layout[pos];
+            auto& bblock = proc.bblocks()[i];
 
-            for (auto& bblock: proc.bblocks())
+            if (pos + 1 < layout.size())
             {
-                std::string name = ".TmpLbl" + std::to_string(tmp_lbl_cnt++);
-                tmp_lbl_names.push_back(std::move(name));
+                fall_through(bblock, layout[pos + 1]);
             }
 
-            for (int i = 0; i < proc.bblocks().size(); ++i)
+            out << tmp_lbl_names[i] << ": # bblock " << bblock.name() << "\n";
+
+            for (auto& inst: bblock.machine_insts())
             {
-                auto& bblock = proc.bblocks()[i];
-                out << tmp_lbl_names[i] << ": # bblock " << bblock.id() << "\n";
+                out << OPCS.at(inst.opc);
 
-                for (auto& inst: bblock.machine_insts())
+                if (inst.id != NO_SYMBOL)
                 {
-                    out << OPCS.at(inst.opc);
+                    out << proc.context()->symbols().name(inst.id) << '\t';
+                }
+
+                std::string junc = "";
 
-                    if (inst.id != "")
+                for (auto& opnd: inst.opnds)
+                {
+                    switch (opnd.kind)
                     {
-                        out << inst.id << '\t';
-                    }
+                        case MachineOperand::Imm:
+                            if (opnd.ty.val == T_ANY_U.val)
+                            {
+                                out << junc << opnd.val;
+                            }
+                            else if (opnd.ty.val == T_ANY_I.val)
+                            {
+                                out << junc << static_cast<std::int64_t>(opnd.val);
+                            }
+                            else if (opnd.ty.val == T_ANY_F.val)
+                            {
+                                out << junc << std::bit_cast<double>(opnd.val);
+                            }
+                            else
+                            {
+                                std::cerr << "unexpected type" << std::endl;
+                                abort();
+                            }
 
-                    std::string junc = "";
+                            break;
 
-                    for (auto& opnd: inst.opnds)
-                    {
-                        switch (opnd.kind)
-                        {
-                            case MachineOperand::Imm:
-                                if (opnd.ty.val == T_ANY_U.val)
-                                {
-                                    out << junc << opnd.val;
-                                }
-                                else if (opnd.ty.val == T_ANY_I.val)
-                                {
-                                    out << junc << static_cast<std::int64_t>(opnd.val);
-                                }
-                                else if (opnd.ty.val == T_ANY_F.val)
-                                {
-                                    out << junc << std::bit_cast<double>(opnd.val);
-                                }
-                                else
-                                {
-                                    std::cerr << "unexpected type" << std::endl;
-                                    abort();
-                                }
-
-                                break;
-
-                            case MachineOperand::Register:
-                                out.flush();
-                                out << junc << PHYS_REGS.at(opnd.val);
-                                break;
-
-                            case MachineOperand::MemAddr:
-                                out << junc;
-
-                                switch (inst.size)
-                                {
-                                default:
-                                    std::cerr << "unexpected size: " << inst.size << std::endl;
-                                    abort();
-
-                                case  8: out << "hword ptr ["; break;
-                                case 16: out <<  "word ptr ["; break;
-                                case 32: out << "dword ptr ["; break;
-                                case 64: out << "qword ptr ["; break;
-                                }
-
-                                out << PHYS_REGS.at(opnd.val);
-
-                                if (opnd.offset < 0)
-                                {
-                                    out << " - " << -opnd.offset;
-                                }
-                                else
-                                {
-                                    out << " + " << opnd.offset;
-                                }
-
-                                out << "]";
-                                break;
-
-                            case MachineOperand::FrameSlot:
-                                std::cerr << "unreachable" << std::endl;
+                        case MachineOperand::Register:
+                            out.flush();
+                            out << junc << PHYS_REGS.at(opnd.val);
+                            break;
+
+                        case MachineOperand::MemAddr:
+                            out << junc;
+
+                            switch (inst.size)
+                            {
+                            default:
+                                std::cerr << "unexpected size: " << inst.size << std::endl;
                                 abort();
 
-                            case MachineOperand::BBlockAddress:
-                                out << junc << tmp_lbl_names[opnd.val];
-                                break;
-                        }
+                            case  8: out << "hword ptr ["; break;
+                            case 16: out <<  "word ptr ["; break;
+                            case 32: out << "dword ptr ["; break;
+                            case 64: out << "qword ptr ["; break;
+                            }
+
+                            out << PHYS_REGS.at(opnd.val);
 
-                        junc = ", ";
+                            if (opnd.offset < 0)
+                            {
+                                out << " - " << -opnd.offset;
+                            }
+                            else
+                            {
+                                out << " + " << opnd.offset;
+                            }
+
+                            out << "]";
+                            break;
+
+                        case MachineOperand::FrameSlot:
+                            std::cerr << "unreachable" << std::endl;
+                            abort();
+
+                        case MachineOperand::BBlockAddress:
+                            out << junc << tmp_lbl_names[opnd.val];
+                            break;
                     }
 
-                    out << "\n";
+                    junc = ", ";
                 }
+
+                out << "\n";
             }
+        }
+
+        auto end_lbl = ".TmpProcEnd" + std::to_string(_asm_proc_cnt++);
+        out
+            << end_lbl << ":\n"
+            << "\t.size " << proc.name() << ", " << end_lbl << "-" << proc.name() << std::endl;
+    }
 
-            auto end_lbl = ".TmpProcEnd" + std::to_string(proc_cnt++);
-            out
-                << end_lbl << ":\n"
-                << "\t.size " << proc.id() << ", " << end_lbl << "-" << proc.id() << std::endl;
+    void X64Target::print_asm(CompileUnit& unit, std::ostream& out, const std::string& src_filename)
+    {
+        begin_asm(out, src_filename);
+
+        for (auto& proc: unit.procs())
+        {
+            print_proc_asm(*proc, out);
         }
 
         out.flush();
@@ -120,7 +120,6 @@ namespace ucb::x64
     const std::set<RegisterID> CALLER_SAVED_REGS =
     {{
         RAX,
-        RBX,
         RCX,
         RDX,
         RSI,
@@ -131,9 +130,15 @@ namespace ucb::x64
         R11
     }};
 
+    // rbp is saved with the frame
     const std::set<RegisterID> CALLEE_SAVED_REGS =
-    {
-    };
+    {{
+        RBX,
+        R12,
+        R13,
+        R14,
+        R15
+    }};
 
     const RegisterID RETURN_REGISTERS[] = { RAX, RDX };
     const RegisterID ARG_REGISTERS[] = { RDI, RSI, RDX, RCX, R8, R9 };
@@ -141,19 +146,27 @@ namespace ucb::x64
     class X64Target : public Target
     {
     public:
-        std::vector<Pat> load_pats() override;
-        std::vector<RegisterClass> load_reg_classes() override;
+        std::span<const Pat> load_pats() override;
+        const std::vector<RegisterClass>& load_reg_classes() override;
 
         bool is_rr_move(MachineOpc opc) override;
+        MachineInstruction load_from_slot(RegisterID reg, TypeID ty, std::uint64_t slot) override;
+        MachineInstruction store_to_slot(RegisterID reg, TypeID ty, std::uint64_t slot) override;
 
         void dump_proc(Procedure& proc, std::ostream& out) override;
         void dump_bblock(BasicBlock& bblock, std::ostream& out) override;
         void abi_lower(Procedure& proc) override;
         void stack_lower(Procedure& proc) override;
 
+        void begin_asm(std::ostream& out, const std::string& src_filename) override;
+        void print_proc_asm(Procedure& proc, std::ostream& out) override;
         void print_asm(CompileUnit& unit, std::ostream& out, const std::string& src_filename) override;
 
     private:
+        // label numbers run on across the procedures of a file
+        int _asm_proc_cnt{0};
+        int _asm_lbl_cnt{0};
+
         void dump_inst(MachineInstruction& inst, std::ostream& out);
     };
 }
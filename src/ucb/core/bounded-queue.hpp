@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace ucb
+{
+    // fifo between pipeline stages that holds at most capacity items, push
+    // waits for room and pop for an item. once closed, pops drain what is
+    // left and then fail
+    template<typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(std::size_t capacity):
+            _capacity{capacity}
+        {
+            assert(_capacity > 0);
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator = (const BoundedQueue&) = delete;
+
+        void push(T item)
+        {
+            {
+                std::unique_lock lock(_mutex);
+                _not_full.wait(lock, [&] { return _items.size() < _capacity; });
+
+                assert(!_closed && "push on a closed queue");
+                _items.push_back(std::move(item));
+            }
+
+            _not_empty.notify_one();
+        }
+
+        // false once the queue is closed and empty
+        bool pop(T& item)
+        {
+            {
+                std::unique_lock lock(_mutex);
+                _not_empty.wait(lock, [&] { return !_items.empty() || _closed; });
+
+                if (_items.empty())
+                {
+                    return false;
+                }
+
+                item = std::move(_items.front());
+                _items.pop_front();
+            }
+
+            _not_full.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard lock(_mutex);
+                _closed = true;
+            }
+
+            _not_empty.notify_all();
+        }
+
+    private:
+        std::size_t _capacity;
+        std::mutex _mutex;
+        std::condition_variable _not_full;
+        std::condition_variable _not_empty;
+        std::deque<T> _items;
+        bool _closed{false};
+    };
+}
@@ -5,15 +5,31 @@
 
 namespace ucb
 {
+    BasicBlock::BasicBlock(Procedure *parent, SymbolID id, std::uint32_t idx):
+        _parent{parent},
+        _bblocks{&parent->bblocks()},
+        _id(id),
+        _idx{idx},
+        _insts(this, parent->arena()),
+        _machine_insts(this, parent->arena())
+    {
+        assert(_parent);
+    }
+
     CompileUnit* BasicBlock::context()
     {
         return _parent->context();
     }
 
+    std::string_view BasicBlock::name()
+    {
+        return context()->symbols().name(_id);
+    }
+
     void BasicBlock::clear_dataflow()
     {
-        _predecessors.clear();
-        _successors.clear();
+        _predecessors = {};
+        _successors = {};
         clear_lifetimes();
     }
 
@@ -21,162 +37,135 @@ namespace ucb
     {
         _live_ins.clear();
         _live_outs.clear();
+        _gen.clear();
+        _kill.clear();
+        _live_in_set.clear();
+        _live_out_set.clear();
     }
 
-    bool BasicBlock::compute_live_ins()
+    static void record_reg_ty(BasicBlock::RegTyTable& reg_tys, RegisterID reg, TypeID ty)
     {
-        std::vector<std::pair<RegisterID, TypeID>> new_live_ins;
-
-        for (auto bblock: _successors)
+        if (reg.val >= reg_tys.size())
         {
-            //bblock->compute_live_ins();
+            reg_tys.resize(reg.val + 1, std::make_pair(NO_REG, T_NONE));
+        }
 
-            new_live_ins.insert(
-                new_live_ins.begin(),
-                bblock->_live_ins.begin(),
-                bblock->_live_ins.end());
+        if (reg_tys[reg.val].first == NO_REG)
+        {
+            reg_tys[reg.val] = std::make_pair(reg, ty);
         }
+    }
+
+    void BasicBlock::compute_gen_kill(RegTyTable& reg_tys)
+    {
+        _gen.clear();
+        _kill.clear();
 
-        for (auto it = _insts.rbegin(); it != _insts.rend(); it++)
+        for (auto& inst: _insts)
         {
-            auto& opnds = it->opnds();
+            auto& opnds = inst.opnds();
 
+            // uses are read before the instruction defines anything
             for (auto& opnd: opnds)
             {
-                if (opnd.is_def())
-                {
-                    auto reg = opnd.get_virtual_reg();
-                    auto it = std::find_if(
-                        new_live_ins.begin(),
-                        new_live_ins.end(),
-                        [reg](auto pair) { return pair.first == reg; });
-
-                    if (it != new_live_ins.end())
-                    {
-                        new_live_ins.erase(it);
-                    }
-                }
-                else if (opnd.kind() == OperandKind::OK_VIRTUAL_REG)
+                if (!opnd.is_def() && opnd.kind() == OperandKind::OK_VIRTUAL_REG)
                 {
                     auto reg = opnd.get_virtual_reg();
-                    auto live_in = std::find_if(
-                        new_live_ins.begin(),
-                        new_live_ins.end(),
-                        [reg](auto pair) { return pair.first == reg; });
+                    record_reg_ty(reg_tys, reg, opnd.ty());
 
-                    if (live_in == new_live_ins.end())
+                    if (!_kill.contains(reg))
                     {
-                        new_live_ins.emplace_back(reg, opnd.ty());
+                        _gen.insert(reg);
                     }
                 }
             }
-        }
-
-        for (auto li: new_live_ins)
-        {
-            auto it = std::find(_live_ins.begin(), _live_ins.end(), li);
 
-            if (it == _live_ins.end())
+            for (auto& opnd: opnds)
             {
-                _live_ins = std::move(new_live_ins);
-                return true;
+                if (opnd.is_def())
+                {
+                    auto reg = opnd.get_virtual_reg();
+                    record_reg_ty(reg_tys, reg, opnd.ty());
+                    _kill.insert(reg);
+                }
             }
         }
-
-        return false;
     }
 
-    bool BasicBlock::compute_machine_live_ins()
+    void BasicBlock::compute_machine_gen_kill(RegTyTable& reg_tys)
     {
-        std::vector<std::pair<RegisterID, TypeID>> new_live_ins;
+        _gen.clear();
+        _kill.clear();
 
-        for (auto bblock: _successors)
+        for (auto& inst: _machine_insts)
         {
-            new_live_ins.insert(
-                new_live_ins.begin(),
-                bblock->_live_ins.begin(),
-                bblock->_live_ins.end());
-        }
-
-        for (auto it = _machine_insts.rbegin(); it != _machine_insts.rend(); it++)
-        {
-            auto& opnds = it->opnds;
-
-            for (auto& opnd: opnds)
+            for (auto& opnd: inst.opnds)
             {
-                if (opnd.is_def)
+                if (opnd.kind == MachineOperand::Register && (!opnd.is_def || opnd.is_use))
                 {
                     auto reg = std::bit_cast<RegisterID>(opnd.val);
-                    auto it = std::find_if(
-                        new_live_ins.begin(),
-                        new_live_ins.end(),
-                        [reg](auto pair) { return pair.first == reg; });
+                    record_reg_ty(reg_tys, reg, opnd.ty);
 
-                    if (it != new_live_ins.end())
+                    if (!_kill.contains(reg))
                     {
-                        new_live_ins.erase(it);
+                        _gen.insert(reg);
                     }
                 }
-                else if (opnd.kind == MachineOperand::Register)
+            }
+
+            for (auto& opnd: inst.opnds)
+            {
+                if (opnd.is_def)
                 {
                     auto reg = std::bit_cast<RegisterID>(opnd.val);
-                    auto live_in = std::find_if(
-                        new_live_ins.begin(),
-                        new_live_ins.end(),
-                        [reg](auto pair) { return pair.first == reg; });
-
-                    if (live_in == new_live_ins.end())
-                    {
-                        new_live_ins.push_back(std::make_pair(reg, opnd.ty));
-                    }
+                    record_reg_ty(reg_tys, reg, opnd.ty);
+                    _kill.insert(reg);
                 }
             }
         }
+    }
+
+    bool BasicBlock::update_liveness()
+    {
+        _live_out_set.clear();
 
-        for (auto li: new_live_ins)
+        for (auto bblock: successors())
         {
-            auto it = std::find(_live_ins.begin(), _live_ins.end(), li);
+            _live_out_set.merge(bblock->_live_in_set);
+        }
 
-            if (it == _live_ins.end())
-            {
-                _live_ins = std::move(new_live_ins);
-                return true;
-            }
+        LiveSet new_live_ins;
+        new_live_ins.assign_transfer(_gen, _live_out_set, _kill);
+
+        if (new_live_ins == _live_in_set)
+        {
+            return false;
         }
 
-        return false;
+        _live_in_set = std::move(new_live_ins);
+        return true;
     }
 
-    void BasicBlock::compute_live_outs()
+    void BasicBlock::build_live_lists(const RegTyTable& reg_tys)
     {
-        for (auto& bblock: _successors)
-        {
-            for (auto reg: bblock->_live_ins)
-            {
-                auto it = std::find(
-                    _live_outs.begin(),
-                    _live_outs.end(),
-                    reg);
+        _live_ins.clear();
+        _live_outs.clear();
 
-                if (it == _live_outs.end())
-                {
-                    _live_outs.push_back(reg);
-                }
-            }
-        }
+        _live_in_set.for_each([&](auto val) { _live_ins.push_back(reg_tys[val]); });
+        _live_out_set.for_each([&](auto val) { _live_outs.push_back(reg_tys[val]); });
     }
 
     void BasicBlock::dump(std::ostream& out)
     {
-        out << _id << ":\n";
+        out << name() << ":\n";
 
         if (!_predecessors.empty())
         {
             out << "\tpredecessors:\n";
 
-            for (auto pred: _predecessors)
+            for (auto pred: predecessors())
             {
-                out << "\t\t" << pred->id() << "\n";
+                out << "\t\t" << pred->name() << "\n";
             }
 
             out << "\n";
@@ -213,11 +202,6 @@ namespace ucb
     {
         if (reg == NO_REG) { return false; }
 
-        auto it = std::find_if(
-            _live_outs.begin(),
-            _live_outs.end(),
-            [reg](auto r) { return r.first == reg; });
-
-        return it != _live_outs.end();
+        return _live_out_set.contains(reg);
     }
 }
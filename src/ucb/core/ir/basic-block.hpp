@@ -1,31 +1,109 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
 #include <list>
 #include <ostream>
+#include <span>
 
+#include <ucb/core/arena.hpp>
 #include <ucb/core/ir/instruction.hpp>
+#include <ucb/core/ir/live-set.hpp>
 #include <ucb/core/ir/machine-instruction.hpp>
 //#include <ucb/core/ir/procedure.hpp>
 
 namespace ucb
 {
-    class BasicBlock
+    using InstList = IList<Instruction, BasicBlock>;
+    using MachineInstList = IList<MachineInstruction, BasicBlock>;
+
+    // predecessors or successors of a block. the edges are indexes into the
+    // procedure's blocks, kept together in one array per direction
+    class BlockRange
     {
     public:
-        BasicBlock(Procedure *parent, std::string id):
-            _parent{parent},
-            _id(std::move(id))
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = BasicBlock*;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = BasicBlock*;
+
+            iterator() = default;
+
+            iterator(const std::uint32_t *it, std::deque<BasicBlock> *bblocks):
+                _it{it},
+                _bblocks{bblocks}
+            {
+            }
+
+            BasicBlock* operator * () const;
+
+            iterator& operator ++ ()
+            {
+                ++_it;
+                return *this;
+            }
+
+            iterator operator ++ (int)
+            {
+                auto res = *this;
+                ++_it;
+                return res;
+            }
+
+            bool operator == (const iterator& other) const { return _it == other._it; }
+
+        private:
+            const std::uint32_t *_it{nullptr};
+            std::deque<BasicBlock> *_bblocks{nullptr};
+        };
+
+        BlockRange() = default;
+
+        BlockRange(std::span<const std::uint32_t> idxs, std::deque<BasicBlock> *bblocks):
+            _idxs{idxs},
+            _bblocks{bblocks}
         {
-            assert(_parent);
         }
 
+        iterator begin() const { return { _idxs.data(), _bblocks }; }
+        iterator end() const { return { _idxs.data() + _idxs.size(), _bblocks }; }
+        std::size_t size() const { return _idxs.size(); }
+        bool empty() const { return _idxs.empty(); }
+        BasicBlock* operator [] (std::size_t i) const;
+
+        std::span<const std::uint32_t> idxs() const { return _idxs; }
+
+    private:
+        std::span<const std::uint32_t> _idxs;
+        std::deque<BasicBlock> *_bblocks{nullptr};
+    };
+
+    class BasicBlock
+    {
+    public:
+        friend Procedure;
+
+        BasicBlock(Procedure *parent, SymbolID id, std::uint32_t idx);
+
         Procedure* parent() { return _parent; }
-        const std::string& id() const { return _id; }
+        SymbolID id() const { return _id; }
+        // position in the procedure's blocks, blocks never move
+        std::uint32_t idx() const { return _idx; }
+        std::string_view name();
 
-        bool compute_live_ins();
-        bool compute_machine_live_ins();
-        void compute_live_outs();
+        using RegTyTable = std::vector<std::pair<RegisterID, TypeID>>;
+
+        void compute_gen_kill(RegTyTable& reg_tys);
+        void compute_machine_gen_kill(RegTyTable& reg_tys);
+        bool update_liveness();
+        void build_live_lists(const RegTyTable& reg_tys);
 
         template<typename ...ARGS>
         Instruction& append_instr(ARGS... args)
@@ -39,6 +117,13 @@ namespace ucb
             return _insts.emplace_front(this, std::forward<ARGS>(args)...);
         }
 
+        // inserts before pos
+        template<typename ...ARGS>
+        Instruction& insert_instr(InstList::iterator pos, ARGS... args)
+        {
+            return _insts.emplace(pos, this, std::forward<ARGS>(args)...);
+        }
+
         template<typename ...ARGS>
         MachineInstruction& append_machine_instr(ARGS... args)
         {
@@ -53,23 +138,36 @@ namespace ucb
 
         void append_machine_insts(std::list<MachineInstruction> insts)
         {
-            _machine_insts.insert(
-                _machine_insts.end(),
-                std::make_move_iterator(insts.begin()),
-                std::make_move_iterator(insts.end())
-            );
+            for (auto& inst: insts)
+            {
+                _machine_insts.emplace_back(std::move(inst));
+            }
         }
 
         void clear_dataflow();
         void clear_lifetimes();
 
-        std::list<Instruction>& insts() { return _insts; }
-        std::list<MachineInstruction>& machine_insts() { return _machine_insts; }
+        InstList& insts() { return _insts; }
+        MachineInstList& machine_insts() { return _machine_insts; }
 
-        std::vector<BasicBlock*>& predecessors() { return _predecessors; }
-        std::vector<BasicBlock*>& successors() { return _successors; }
+        // filled by Procedure::compute_predecessors, blocks added after it
+        // have no edges until it runs again
+        BlockRange predecessors() const { return { _predecessors, _bblocks }; }
+        BlockRange successors() const { return { _successors, _bblocks }; }
         std::vector<std::pair<RegisterID, TypeID>>& live_ins() { return _live_ins; }
         std::vector<std::pair<RegisterID, TypeID>>& live_outs() { return _live_outs; }
+        const LiveSet& live_in_set() const { return _live_in_set; }
+        const LiveSet& live_out_set() const { return _live_out_set; }
+
+        // filled by Procedure::compute_loop_info, the entry block and
+        // unreachable blocks have no immediate dominator
+        BasicBlock* idom() { return _idom; }
+        std::vector<BasicBlock*>& dom_children() { return _dom_children; }
+        // innermost loop in the procedure's loops, -1 outside of any loop
+        int loop() const { return _loop; }
+        int loop_depth() const { return _loop_depth; }
+        // estimated executions per call of the procedure
+        float frequency() const { return _frequency; }
 
         bool reg_is_live_out(RegisterID reg);
 
@@ -80,13 +178,37 @@ namespace ucb
 
     private:
         Procedure *_parent;
-        std::string _id;
-        std::list<Instruction> _insts;
-        std::list<MachineInstruction> _machine_insts;
-
-        std::vector<BasicBlock*> _predecessors;
-        std::vector<BasicBlock*> _successors;
+        std::deque<BasicBlock> *_bblocks;
+        SymbolID _id;
+        std::uint32_t _idx;
+        InstList _insts;
+        MachineInstList _machine_insts;
+
+        // slices of the procedure's edge arrays
+        std::span<const std::uint32_t> _predecessors;
+        std::span<const std::uint32_t> _successors;
         std::vector<std::pair<RegisterID, TypeID>> _live_ins;
         std::vector<std::pair<RegisterID, TypeID>> _live_outs;
+
+        BasicBlock *_idom{nullptr};
+        std::vector<BasicBlock*> _dom_children;
+        int _loop{-1};
+        int _loop_depth{0};
+        float _frequency{1};
+
+        LiveSet _gen;
+        LiveSet _kill;
+        LiveSet _live_in_set;
+        LiveSet _live_out_set;
     };
+
+    inline BasicBlock* BlockRange::iterator::operator * () const
+    {
+        return &(*_bblocks)[*_it];
+    }
+
+    inline BasicBlock* BlockRange::operator [] (std::size_t i) const
+    {
+        return &(*_bblocks)[_idxs[i]];
+    }
 }
@@ -0,0 +1,694 @@
+#include <ucb/core/ir/binary.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ucb
+{
+    enum RegKind : std::uint8_t
+    {
+        RK_PARAM,
+        RK_FRAME,
+        RK_REG
+    };
+
+    constexpr std::size_t HEADER_SIZE = 4 + 4 + 3 * 8;
+
+    class Encoder
+    {
+    public:
+        void u8(std::uint8_t val)
+        {
+            _buf.push_back(static_cast<char>(val));
+        }
+
+        void uleb(std::uint64_t val)
+        {
+            do
+            {
+                auto byte = static_cast<std::uint8_t>(val & 0x7f);
+                val >>= 7;
+                u8(val != 0 ? byte | 0x80 : byte);
+            }
+            while (val != 0);
+        }
+
+        // zigzag, so small negative values stay small
+        void sleb(std::int64_t val)
+        {
+            uleb((static_cast<std::uint64_t>(val) << 1) ^ static_cast<std::uint64_t>(val >> 63));
+        }
+
+        void fixed(std::uint64_t val, int size)
+        {
+            for (int i = 0; i < size; ++i)
+            {
+                u8(static_cast<std::uint8_t>(val >> (8 * i)));
+            }
+        }
+
+        void bytes(std::string_view val)
+        {
+            _buf.append(val);
+        }
+
+        void ty(TypeID ty)
+        {
+            sleb(ty.val);
+            uleb(ty.size);
+        }
+
+        std::string& buf() { return _buf; }
+
+    private:
+        std::string _buf;
+    };
+
+    // reads past the end leave the decoder failed and return zeros, callers
+    // check ok() once they are done
+    class Decoder
+    {
+    public:
+        explicit Decoder(std::string_view data):
+            _data{data}
+        {
+        }
+
+        bool ok() const { return _ok; }
+
+        std::uint8_t u8()
+        {
+            if (_pos >= _data.size())
+            {
+                _ok = false;
+                return 0;
+            }
+
+            return static_cast<std::uint8_t>(_data[_pos++]);
+        }
+
+        std::uint64_t uleb()
+        {
+            std::uint64_t res = 0;
+
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                auto byte = u8();
+                res |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+                if ((byte & 0x80) == 0)
+                {
+                    return res;
+                }
+            }
+
+            _ok = false;
+            return 0;
+        }
+
+        std::int64_t sleb()
+        {
+            auto val = uleb();
+            return static_cast<std::int64_t>(val >> 1) ^ -static_cast<std::int64_t>(val & 1);
+        }
+
+        std::uint64_t fixed(int size)
+        {
+            std::uint64_t res = 0;
+
+            for (int i = 0; i < size; ++i)
+            {
+                res |= static_cast<std::uint64_t>(u8()) << (8 * i);
+            }
+
+            return res;
+        }
+
+        std::string_view bytes(std::size_t size)
+        {
+            if (size > _data.size() - std::min(_pos, _data.size()))
+            {
+                _ok = false;
+                return {};
+            }
+
+            auto res = _data.substr(_pos, size);
+            _pos += size;
+            return res;
+        }
+
+        TypeID raw_ty()
+        {
+            auto val = sleb();
+            auto size = uleb();
+            return { val, size };
+        }
+
+    private:
+        std::string_view _data;
+        std::size_t _pos{0};
+        bool _ok{true};
+    };
+
+    static void write_proc(Procedure& proc, Encoder& enc)
+    {
+        auto& sig = proc.signature();
+
+        enc.ty(sig.ret());
+        enc.uleb(sig.args().size());
+
+        for (auto& [id, ty]: sig.args())
+        {
+            enc.uleb(id.val);
+            enc.ty(ty);
+        }
+
+        // registers are numbered as they are created, writing them in that
+        // order lets the reader number them the same way
+        std::vector<std::tuple<RegisterID, RegKind, const VirtualRegister*>> regs;
+
+        for (auto& [reg, vreg]: proc.params()) { regs.emplace_back(reg, RK_PARAM, &vreg); }
+        for (auto& [reg, vreg]: proc.frame()) { regs.emplace_back(reg, RK_FRAME, &vreg); }
+        for (auto& [reg, vreg]: proc.regs()) { regs.emplace_back(reg, RK_REG, &vreg); }
+
+        std::sort(regs.begin(), regs.end(), [](auto& a, auto& b)
+        {
+            return std::get<0>(a) < std::get<0>(b);
+        });
+
+        enc.uleb(regs.size());
+
+        for (auto& [reg, kind, vreg]: regs)
+        {
+            enc.u8(kind);
+            enc.uleb(reg.val);
+            enc.uleb(vreg->id().val);
+            enc.ty(vreg->ty());
+        }
+
+        enc.uleb(proc.bblocks().size());
+
+        for (auto& bblock: proc.bblocks())
+        {
+            enc.uleb(bblock.id().val);
+        }
+
+        for (auto& bblock: proc.bblocks())
+        {
+            enc.uleb(bblock.insts().size());
+
+            for (auto& inst: bblock.insts())
+            {
+                enc.u8(inst.op());
+                enc.ty(inst.ty());
+                enc.uleb(inst.id().val);
+                enc.uleb(inst.opnds().size());
+
+                for (auto& opnd: inst.opnds())
+                {
+                    enc.u8(opnd.kind() | (opnd.is_def() ? 0x80 : 0));
+                    enc.ty(opnd.ty());
+
+                    switch (opnd.kind())
+                    {
+                        case OperandKind::OK_VIRTUAL_REG:
+                            enc.uleb(opnd.get_virtual_reg().val);
+                            break;
+
+                        case OperandKind::OK_BASIC_BLOCK:
+                            enc.uleb(opnd.get_bblock_idx());
+                            break;
+
+                        case OperandKind::OK_INTEGER_CONST:
+                            enc.sleb(opnd.get_integer_val());
+                            break;
+
+                        case OperandKind::OK_UNSIGNED_CONST:
+                            enc.uleb(opnd.get_unsigned_val());
+                            break;
+
+                        case OperandKind::OK_FLOAT_CONST:
+                            enc.fixed(std::bit_cast<std::uint64_t>(opnd.get_float_val()), 8);
+                            break;
+
+                        default:
+                            std::cerr << "operand kind " << opnd.kind() << " has no binary encoding" << std::endl;
+                            abort();
+                    }
+                }
+            }
+        }
+    }
+
+    void write_binary(CompileUnit& unit, std::ostream& out)
+    {
+        Encoder tables;
+        auto& symbols = unit.symbols();
+        auto symbols_offset = HEADER_SIZE;
+
+        tables.uleb(symbols.size());
+
+        for (std::uint32_t i = 1; i < symbols.size(); ++i)
+        {
+            auto name = symbols.name({ i });
+            tables.uleb(name.size());
+            tables.bytes(name);
+        }
+
+        auto types_offset = HEADER_SIZE + tables.buf().size();
+        auto& comp_tys = unit.comp_tys();
+
+        tables.uleb(comp_tys.size());
+
+        for (auto& [id, cty]: comp_tys)
+        {
+            tables.u8(cty.kind());
+            tables.sleb(cty.size());
+            tables.ty(cty.sub());
+        }
+
+        // the procedures go after the table that points at them, so they
+        // are encoded first to learn their sizes
+        Encoder procs;
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> extents;
+
+        for (auto& proc: unit.procs())
+        {
+            auto start = procs.buf().size();
+            write_proc(*proc, procs);
+            extents.emplace_back(start, procs.buf().size() - start);
+        }
+
+        auto procs_offset = HEADER_SIZE + tables.buf().size();
+
+        // offsets are fixed size, so the table is as long whatever the base
+        // and can be laid out once to find where the procedures start
+        auto make_table = [&](std::uint64_t base)
+        {
+            Encoder table;
+            table.uleb(unit.procs().size());
+
+            for (std::size_t i = 0; i < extents.size(); ++i)
+            {
+                table.uleb(unit.procs()[i]->id().val);
+                table.fixed(base + extents[i].first, 8);
+                table.fixed(extents[i].second, 8);
+            }
+
+            return table;
+        };
+
+        auto table = make_table(0);
+        table = make_table(procs_offset + table.buf().size());
+
+        Encoder header;
+        header.fixed(BINARY_MAGIC, 4);
+        header.fixed(BINARY_VERSION, 4);
+        header.fixed(symbols_offset, 8);
+        header.fixed(types_offset, 8);
+        header.fixed(procs_offset, 8);
+
+        out.write(header.buf().data(), header.buf().size());
+        out.write(tables.buf().data(), tables.buf().size());
+        out.write(table.buf().data(), table.buf().size());
+        out.write(procs.buf().data(), procs.buf().size());
+    }
+
+    bool is_binary(std::string_view data)
+    {
+        return data.size() >= 4 && Decoder(data).fixed(4) == BINARY_MAGIC;
+    }
+
+    BinaryReader::BinaryReader(std::shared_ptr<CompileUnit> unit):
+        _unit{std::move(unit)}
+    {
+    }
+
+    BinaryReader::~BinaryReader()
+    {
+        if (_map != nullptr)
+        {
+            munmap(_map, _map_size);
+        }
+    }
+
+    bool BinaryReader::open(const std::string& filename)
+    {
+        _filename = filename;
+
+        auto fd = ::open(filename.c_str(), O_RDONLY);
+
+        if (fd == -1)
+        {
+            std::cerr << "could not open binary unit " << filename << std::endl;
+            return false;
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(HEADER_SIZE))
+        {
+            std::cerr << "binary unit " << filename << " is truncated" << std::endl;
+            ::close(fd);
+            return false;
+        }
+
+        auto map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "could not map binary unit " << filename << std::endl;
+            return false;
+        }
+
+        _map = map;
+        _map_size = st.st_size;
+
+        return _load_tables(std::string_view(static_cast<const char*>(_map), _map_size));
+    }
+
+    bool BinaryReader::_load_tables(std::string_view data)
+    {
+        Decoder header(data);
+
+        if (header.fixed(4) != BINARY_MAGIC)
+        {
+            std::cerr << _filename << " is not a binary unit" << std::endl;
+            return false;
+        }
+
+        if (auto version = header.fixed(4); version != BINARY_VERSION)
+        {
+            std::cerr << "binary unit " << _filename << " has version " << version
+                << ", expected " << BINARY_VERSION << std::endl;
+            return false;
+        }
+
+        auto symbols_offset = header.fixed(8);
+        auto types_offset = header.fixed(8);
+        auto procs_offset = header.fixed(8);
+
+        if (symbols_offset > data.size() || types_offset > data.size() || procs_offset > data.size())
+        {
+            std::cerr << "binary unit " << _filename << " is truncated" << std::endl;
+            return false;
+        }
+
+        Decoder symbols(data.substr(symbols_offset));
+        auto symbol_cnt = symbols.uleb();
+
+        _symbols.clear();
+        _symbols.push_back(NO_SYMBOL);
+
+        for (std::uint64_t i = 1; i < symbol_cnt && symbols.ok(); ++i)
+        {
+            auto name = symbols.bytes(symbols.uleb());
+            _symbols.push_back(_unit->symbols().intern(name));
+        }
+
+        Decoder types(data.substr(types_offset));
+        auto ty_cnt = types.uleb();
+
+        _comp_tys.clear();
+
+        for (std::uint64_t i = 0; i < ty_cnt && types.ok(); ++i)
+        {
+            auto kind = static_cast<CompositeType::CompositeTyKind>(types.u8());
+            auto size = types.sleb();
+            auto sub = types.raw_ty();
+
+            // composite types only refer to the ones interned before them
+            if (sub.val >= COMP_TY_START)
+            {
+                auto idx = static_cast<std::uint64_t>(sub.val - COMP_TY_START);
+
+                if (idx >= _comp_tys.size())
+                {
+                    std::cerr << "binary unit " << _filename << " has a bad type table" << std::endl;
+                    return false;
+                }
+
+                sub = _comp_tys[idx];
+            }
+
+            if (kind == CompositeType::CompositeTyKind::CTK_PTR)
+            {
+                _comp_tys.push_back(_unit->get_ptr_ty(sub));
+            }
+            else
+            {
+                _comp_tys.push_back(_unit->get_arr_ty(sub, size));
+            }
+        }
+
+        Decoder procs(data.substr(procs_offset));
+        auto proc_cnt = procs.uleb();
+
+        _procs.clear();
+
+        for (std::uint64_t i = 0; i < proc_cnt && procs.ok(); ++i)
+        {
+            auto id = procs.uleb();
+            auto offset = procs.fixed(8);
+            auto size = procs.fixed(8);
+
+            if (id >= _symbols.size() || offset > data.size() || size > data.size() - offset)
+            {
+                std::cerr << "binary unit " << _filename << " has a bad procedure table" << std::endl;
+                return false;
+            }
+
+            _procs.push_back({ _symbols[id], offset, size });
+        }
+
+        if (!symbols.ok() || !types.ok() || !procs.ok())
+        {
+            std::cerr << "binary unit " << _filename << " is truncated" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    int BinaryReader::find_proc(SymbolID id) const
+    {
+        for (std::size_t i = 0; i < _procs.size(); ++i)
+        {
+            if (_procs[i].id == id)
+            {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    std::shared_ptr<Procedure> BinaryReader::read_proc(std::size_t idx)
+    {
+        auto& entry = _procs[idx];
+
+        if (auto proc = _unit->get_procedure(entry.id); proc != nullptr)
+        {
+            return proc;
+        }
+
+        auto data = std::string_view(static_cast<const char*>(_map), _map_size);
+        Decoder dec(data.substr(entry.offset, entry.size));
+        auto failed = false;
+
+        auto symbol = [&]()
+        {
+            auto idx = dec.uleb();
+
+            if (idx >= _symbols.size())
+            {
+                failed = true;
+                return NO_SYMBOL;
+            }
+
+            return _symbols[idx];
+        };
+
+        auto ty = [&]()
+        {
+            auto res = dec.raw_ty();
+
+            if (res.val < COMP_TY_START)
+            {
+                return res;
+            }
+
+            auto idx = static_cast<std::uint64_t>(res.val - COMP_TY_START);
+
+            if (idx >= _comp_tys.size())
+            {
+                failed = true;
+                return T_ERROR;
+            }
+
+            return _comp_tys[idx];
+        };
+
+        ProcSignature sig(ty());
+        auto arg_cnt = dec.uleb();
+
+        for (std::uint64_t i = 0; i < arg_cnt && dec.ok() && !failed; ++i)
+        {
+            auto id = symbol();
+            sig.args().emplace_back(id, ty());
+        }
+
+        if (!dec.ok() || failed)
+        {
+            std::cerr << "binary unit " << _filename << " has a bad procedure" << std::endl;
+            return nullptr;
+        }
+
+        // only added to the unit once the whole body decoded
+        auto proc = std::make_shared<Procedure>(_unit.get(), entry.id, std::move(sig));
+
+        // register numbers in the file -> registers of proc
+        std::unordered_map<std::uint64_t, RegisterID> regs;
+        auto reg_cnt = dec.uleb();
+        std::size_t param_idx = 0;
+
+        for (std::uint64_t i = 0; i < reg_cnt && dec.ok() && !failed; ++i)
+        {
+            auto kind = dec.u8();
+            auto val = dec.uleb();
+            auto id = symbol();
+            auto reg_ty = ty();
+
+            switch (kind)
+            {
+                case RK_PARAM:
+                    if (param_idx < proc->params().size())
+                    {
+                        regs[val] = proc->params()[param_idx++].first;
+                    }
+                    else
+                    {
+                        failed = true;
+                    }
+                    break;
+
+                case RK_FRAME:
+                    regs[val] = proc->add_frame_slot(id, reg_ty);
+                    break;
+
+                case RK_REG:
+                    regs[val] = proc->add_vreg(id, reg_ty);
+                    break;
+
+                default:
+                    failed = true;
+            }
+        }
+
+        auto bblock_cnt = dec.uleb();
+
+        for (std::uint64_t i = 0; i < bblock_cnt && dec.ok() && !failed; ++i)
+        {
+            proc->add_bblock(symbol());
+        }
+
+        for (std::uint64_t i = 0; i < bblock_cnt && dec.ok() && !failed; ++i)
+        {
+            auto bblock = proc->get_bblock(i);
+            auto inst_cnt = dec.uleb();
+
+            for (std::uint64_t j = 0; j < inst_cnt && dec.ok() && !failed; ++j)
+            {
+                auto op = static_cast<InstrOpcode>(dec.u8());
+                auto inst_ty = ty();
+                auto& inst = bblock->append_instr(op, inst_ty, symbol());
+                auto opnd_cnt = dec.uleb();
+
+                for (std::uint64_t k = 0; k < opnd_cnt && dec.ok() && !failed; ++k)
+                {
+                    auto tag = dec.u8();
+                    auto kind = static_cast<OperandKind>(tag & 0x7f);
+                    auto is_def = (tag & 0x80) != 0;
+                    auto opnd_ty = ty();
+
+                    switch (kind)
+                    {
+                        case OperandKind::OK_VIRTUAL_REG:
+                        {
+                            auto it = regs.find(dec.uleb());
+
+                            if (it == regs.end())
+                            {
+                                failed = true;
+                                break;
+                            }
+
+                            inst.add_operand(Operand(it->second, opnd_ty, is_def));
+                            break;
+                        }
+
+                        case OperandKind::OK_BASIC_BLOCK:
+                        {
+                            auto idx = dec.uleb();
+
+                            if (idx >= bblock_cnt)
+                            {
+                                failed = true;
+                                break;
+                            }
+
+                            inst.add_operand(Operand(static_cast<int>(idx)));
+                            break;
+                        }
+
+                        case OperandKind::OK_INTEGER_CONST:
+                            inst.add_operand(Operand(static_cast<long int>(dec.sleb()), opnd_ty));
+                            break;
+
+                        case OperandKind::OK_UNSIGNED_CONST:
+                            inst.add_operand(Operand(static_cast<unsigned long>(dec.uleb()), opnd_ty));
+                            break;
+
+                        case OperandKind::OK_FLOAT_CONST:
+                            inst.add_operand(Operand(std::bit_cast<double>(dec.fixed(8)), opnd_ty));
+                            break;
+
+                        default:
+                            failed = true;
+                    }
+                }
+            }
+        }
+
+        if (!dec.ok() || failed)
+        {
+            std::cerr << "binary unit " << _filename << " has a bad procedure" << std::endl;
+            return nullptr;
+        }
+
+        _unit->add_procedure(proc);
+        return proc;
+    }
+
+    bool BinaryReader::read_all()
+    {
+        for (std::size_t i = 0; i < _procs.size(); ++i)
+        {
+            if (read_proc(i) == nullptr)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
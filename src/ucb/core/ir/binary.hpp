@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ucb/core/ir/compile-unit.hpp>
+#include <ucb/core/ir/procedure.hpp>
+#include <ucb/core/ir/symbol.hpp>
+#include <ucb/core/ir/type.hpp>
+
+namespace ucb
+{
+    // binary encoding of a compile unit, all integers are LEB128 unless
+    // noted otherwise:
+    //
+    //   header     magic "UCBB", version (4 bytes each, little endian),
+    //              then the offsets of the three sections below (8 bytes
+    //              each)
+    //   symbols    count, then length and bytes of each name. symbol 0 is
+    //              the empty name and is not written
+    //   types      count, then kind, size and sub type of each composite
+    //              type in the order they were interned
+    //   procs      count, then name, offset and length of each procedure
+    //
+    // a procedure is its signature, its registers in RegisterID order, the
+    // names of its blocks and then the instructions of every block. symbols
+    // and composite types are referred to by their index in the file, so a
+    // procedure can be decoded on its own once the tables are loaded
+    constexpr std::uint32_t BINARY_MAGIC = 0x42424355; // "UCBB"
+    constexpr std::uint32_t BINARY_VERSION = 1;
+
+    void write_binary(CompileUnit& unit, std::ostream& out);
+
+    // whether the first bytes of a file are a binary unit's
+    bool is_binary(std::string_view data);
+
+    // maps a binary unit and decodes procedures into a compile unit on
+    // demand, the symbol and type tables are loaded when it is opened
+    class BinaryReader
+    {
+    public:
+        explicit BinaryReader(std::shared_ptr<CompileUnit> unit);
+        ~BinaryReader();
+
+        BinaryReader(const BinaryReader&) = delete;
+        BinaryReader& operator = (const BinaryReader&) = delete;
+
+        bool open(const std::string& filename);
+
+        std::size_t proc_count() const { return _procs.size(); }
+        SymbolID proc_id(std::size_t idx) const { return _procs[idx].id; }
+        // index of the procedure named id, -1 if the unit has none
+        int find_proc(SymbolID id) const;
+
+        std::shared_ptr<Procedure> read_proc(std::size_t idx);
+        bool read_all();
+
+    private:
+        struct ProcEntry
+        {
+            SymbolID id;
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+
+        std::shared_ptr<CompileUnit> _unit;
+        std::string _filename;
+        void *_map{nullptr};
+        std::size_t _map_size{0};
+
+        // file index -> id in _unit
+        std::vector<SymbolID> _symbols;
+        std::vector<TypeID> _comp_tys;
+        std::vector<ProcEntry> _procs;
+
+        bool _load_tables(std::string_view data);
+    };
+}
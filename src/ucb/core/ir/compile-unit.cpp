@@ -4,34 +4,84 @@
 
 namespace ucb
 {
-    std::shared_ptr<Procedure> CompileUnit::add_procedure(ProcSignature sig, std::string id)
+    std::shared_ptr<Procedure> CompileUnit::add_procedure(ProcSignature sig, SymbolID id)
     {
-        if (get_procedure(id) != nullptr)
+        auto proc = std::make_shared<Procedure>(this, id, std::move(sig));
+        add_procedure(proc);
+        return proc;
+    }
+
+    void CompileUnit::add_procedure(std::shared_ptr<Procedure> proc)
+    {
+        if (!_proc_ids.emplace(proc->id(), _procs.size()).second)
         {
-            std::cerr << "procedure \"" << id << "already exists\n";
+            std::cerr << "procedure \"" << _symbols.name(proc->id()) << "already exists\n";
             abort();
         }
 
-        _procs.push_back(std::make_shared<Procedure>(this, std::move(id), std::move(sig)));
-        return _procs.back();
+        _procs.push_back(std::move(proc));
     }
 
+    std::shared_ptr<Procedure> CompileUnit::get_procedure(SymbolID id)
+    {
+        auto it = _proc_ids.find(id);
+
+        if (it != _proc_ids.end())
+        {
+            return _procs[it->second];
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
 
-    std::shared_ptr<Procedure> CompileUnit::get_procedure(const std::string& id)
+    TypeID CompileUnit::_intern_ty(CompositeType::CompositeTyKind kind, std::int64_t size, TypeID sub, std::uint64_t ty_size)
     {
-        auto it = std::find_if(_procs.begin(), _procs.end(), [&](auto& p)
+        CompTyKey key = { kind, size, sub };
+
         {
-            return p->id() == id;
-        });
+            std::shared_lock lock(_ty_mutex);
+            auto it = _comp_ty_ids.find(key);
 
-        if (it != _procs.end())
+            if (it != _comp_ty_ids.end())
+            {
+                return it->second;
+            }
+        }
+
+        std::unique_lock lock(_ty_mutex);
+
+        // another thread may have interned it while the lock was released
+        auto it = _comp_ty_ids.find(key);
+
+        if (it != _comp_ty_ids.end())
         {
-            return *it;
+            return it->second;
         }
-        else
+
+        TypeID res = { _next_ty_id++, ty_size };
+        _comp_tys.emplace_back(res, CompositeType(this, kind, size, sub));
+        _comp_ty_ids.emplace(key, res);
+        return res;
+    }
+
+    const CompositeType* CompileUnit::get_comp_ty(TypeID ty) const
+    {
+        if (ty.val < COMP_TY_START)
         {
             return nullptr;
         }
+
+        auto idx = static_cast<std::size_t>(ty.val - COMP_TY_START);
+        std::shared_lock lock(_ty_mutex);
+
+        if (idx >= _comp_tys.size() || _comp_tys[idx].first != ty)
+        {
+            return nullptr;
+        }
+
+        return &_comp_tys[idx].second;
     }
 
     void CompileUnit::dump(std::ostream& out)
@@ -50,19 +100,16 @@ namespace ucb
     {
         if (ty.val >= COMP_TY_START)
         {
-            auto it = std::find_if(_comp_tys.begin(), _comp_tys.end(), [&](auto p)
-            {
-                return p.first == ty;
-            });
+            auto cty_ptr = get_comp_ty(ty);
 
-            if (it == _comp_tys.end())
+            if (cty_ptr == nullptr)
             {
                 std::cerr << "type not found\n";
                 std::cerr << ty.val << ", " << ty.size << std::endl;
                 abort();
             }
 
-            auto cty = it->second;
+            auto& cty = *cty_ptr;
 
             switch (cty.kind())
             {
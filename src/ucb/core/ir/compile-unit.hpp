@@ -1,22 +1,37 @@
 #pragma once
 
 #include <algorithm>
+#include <deque>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <ostream>
+#include <shared_mutex>
+#include <unordered_map>
 #include <vector>
 
 #include <ucb/core/ir/procedure.hpp>
+#include <ucb/core/ir/symbol.hpp>
 #include <ucb/core/ir/type.hpp>
 
 namespace ucb
 {
     class Procedure;
 
+    // takes procedures that are passed on as they are made instead of being
+    // kept by a unit
+    using ProcSink = std::function<void(std::shared_ptr<Procedure>)>;
+
     class CompileUnit
     {
     public:
-        std::shared_ptr<Procedure> add_procedure(ProcSignature sig, std::string id);
-        std::shared_ptr<Procedure> get_procedure(const std::string& id);
+        std::shared_ptr<Procedure> add_procedure(ProcSignature sig, SymbolID id);
+        // appends a procedure that was built apart from the unit, like the
+        // ones parsed concurrently
+        void add_procedure(std::shared_ptr<Procedure> proc);
+        std::shared_ptr<Procedure> get_procedure(SymbolID id);
+
+        SymbolTable& symbols() { return _symbols; }
 
         std::vector<std::shared_ptr<Procedure>>& procs()
         {
@@ -25,63 +40,61 @@ namespace ucb
 
         TypeID get_ptr_ty(TypeID sub)
         {
-            CompositeType ty(
-                this,
-                CompositeType::CompositeTyKind::CTK_PTR,
-                64, // shouldnt be hard coded, i know
-                sub
-            );
-
-            auto it = std::find_if(_comp_tys.begin(), _comp_tys.end(), [&](auto p)
-            {
-                return p.second == ty;
-            });
-
-            if (it == _comp_tys.end())
-            {
-                // TODO remove magic word size
-                TypeID res = { _next_ty_id++, 64 };
-                _comp_tys.emplace_back(res, ty);
-                return res;
-            }
-            else
-            {
-                return it->first;
-            }
+            // TODO remove magic word size
+            return _intern_ty(CompositeType::CompositeTyKind::CTK_PTR, 64, sub, 64);
         };
 
         TypeID get_arr_ty(TypeID sub, std::uint64_t size)
         {
-            CompositeType ty(
-                this,
-                CompositeType::CompositeTyKind::CTK_ARR,
-                size,
-                sub
-            );
-
-            auto it = std::find_if(_comp_tys.begin(), _comp_tys.end(), [&](auto p)
-            {
-                return p.second == ty;
-            });
-
-            if (it == _comp_tys.end())
-            {
-                TypeID res = { _next_ty_id++, size };
-                _comp_tys.emplace_back(res, ty);
-                return res;
-            }
-            else
-            {
-                return it->first;
-            }
+            return _intern_ty(CompositeType::CompositeTyKind::CTK_ARR, size, sub, size);
         };
 
+        const CompositeType* get_comp_ty(TypeID ty) const;
+
+        // in the order they were interned, only read while nothing else
+        // can intern a type
+        const std::deque<std::pair<TypeID, CompositeType>>& comp_tys() const
+        {
+            return _comp_tys;
+        }
+
         void dump(std::ostream& out);
         void dump_ty(std::ostream& out, TypeID ty);
 
     private:
+        struct CompTyKey
+        {
+            CompositeType::CompositeTyKind kind;
+            std::int64_t size;
+            TypeID sub;
+
+            bool operator == (const CompTyKey& other) const = default;
+        };
+
+        struct CompTyKeyHash
+        {
+            std::size_t operator () (const CompTyKey& key) const
+            {
+                auto h = std::hash<std::int64_t>{}(key.sub.val);
+                h ^= std::hash<std::int64_t>{}(key.size) + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+                h ^= std::hash<std::uint64_t>{}((key.sub.size << 1) | key.kind) + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+                return h;
+            }
+        };
+
         int _next_ty_id{COMP_TY_START};
-        std::vector<std::pair<TypeID, CompositeType>> _comp_tys;
+        // composite types live on a deque so references stay valid as the
+        // table grows, _comp_ty_ids maps back from the structure to its id.
+        // procedures are compiled concurrently so the table is guarded by
+        // _ty_mutex, lookups only take it shared
+        mutable std::shared_mutex _ty_mutex;
+        std::deque<std::pair<TypeID, CompositeType>> _comp_tys;
+        std::unordered_map<CompTyKey, TypeID, CompTyKeyHash> _comp_ty_ids;
         std::vector<std::shared_ptr<Procedure>> _procs;
+        // id -> index in _procs
+        std::unordered_map<SymbolID, std::size_t> _proc_ids;
+        SymbolTable _symbols;
+
+        TypeID _intern_ty(CompositeType::CompositeTyKind kind, std::int64_t size, TypeID sub, std::uint64_t ty_size);
     };
 }
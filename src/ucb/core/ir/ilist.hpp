@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <utility>
+
+#include <ucb/core/arena.hpp>
+
+namespace ucb
+{
+    template<typename T, typename Owner>
+    class IList;
+
+    // intrusive list hook, instructions inherit from it so they can be
+    // unlinked, inserted or moved to another block in O(1) from a pointer
+    template<typename T, typename Owner>
+    class IListNode
+    {
+    public:
+        friend IList<T, Owner>;
+
+        IListNode() = default;
+
+        explicit IListNode(Owner *parent):
+            _ilist_parent{parent}
+        {
+        }
+
+        // copies are detached from any list
+        IListNode(const IListNode&)
+        {
+        }
+
+        IListNode& operator = (const IListNode&)
+        {
+            return *this;
+        }
+
+        Owner* parent() { return _ilist_parent; }
+        const Owner* parent() const { return _ilist_parent; }
+
+        T* next() { return _ilist_next; }
+        T* prev() { return _ilist_prev; }
+
+    protected:
+        Owner *_ilist_parent{nullptr};
+
+    private:
+        T *_ilist_prev{nullptr};
+        T *_ilist_next{nullptr};
+    };
+
+    // doubly linked list over IListNode hooks, the nodes are allocated from
+    // an arena and destroyed when erased or when the list goes away
+    template<typename T, typename Owner>
+    class IList
+    {
+    public:
+        template<typename V>
+        class Iterator
+        {
+        public:
+            friend IList;
+
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = V*;
+            using reference = V&;
+
+            Iterator() = default;
+
+            template<typename U>
+            Iterator(const Iterator<U>& other):
+                _node{other._node},
+                _list{other._list}
+            {
+            }
+
+            reference operator * () const { return *_node; }
+            pointer operator -> () const { return _node; }
+            pointer ptr() const { return _node; }
+
+            Iterator& operator ++ ()
+            {
+                _node = _node->_ilist_next;
+                return *this;
+            }
+
+            Iterator operator ++ (int)
+            {
+                auto res = *this;
+                ++*this;
+                return res;
+            }
+
+            Iterator& operator -- ()
+            {
+                _node = _node == nullptr ? _list->_tail : _node->_ilist_prev;
+                return *this;
+            }
+
+            Iterator operator -- (int)
+            {
+                auto res = *this;
+                --*this;
+                return res;
+            }
+
+            template<typename U>
+            bool operator == (const Iterator<U>& other) const { return _node == other._node; }
+
+        private:
+            template<typename U>
+            friend class Iterator;
+
+            V *_node{nullptr};
+            const IList *_list{nullptr};
+
+            Iterator(V *node, const IList *list):
+                _node{node},
+                _list{list}
+            {
+            }
+        };
+
+        using iterator = Iterator<T>;
+        using const_iterator = Iterator<const T>;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        IList(Owner *owner, Arena *arena):
+            _owner{owner},
+            _arena{arena}
+        {
+            assert(_arena);
+        }
+
+        IList(const IList&) = delete;
+        IList& operator = (const IList&) = delete;
+
+        IList(IList&& other) noexcept:
+            _owner{other._owner},
+            _arena{other._arena},
+            _head{other._head},
+            _tail{other._tail},
+            _size{other._size}
+        {
+            other._head = nullptr;
+            other._tail = nullptr;
+            other._size = 0;
+        }
+
+        ~IList()
+        {
+            clear();
+        }
+
+        iterator begin() { return { _head, this }; }
+        iterator end() { return { nullptr, this }; }
+        const_iterator begin() const { return { _head, this }; }
+        const_iterator end() const { return { nullptr, this }; }
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+
+        iterator iterator_to(T *node) { return { node, this }; }
+
+        T& front() { assert(_head); return *_head; }
+        T& back() { assert(_tail); return *_tail; }
+
+        bool empty() const { return _size == 0; }
+        std::size_t size() const { return _size; }
+
+        template<typename ...ARGS>
+        T& emplace_back(ARGS&&... args)
+        {
+            return *insert(end(), _make(std::forward<ARGS>(args)...));
+        }
+
+        template<typename ...ARGS>
+        T& emplace_front(ARGS&&... args)
+        {
+            return *insert(begin(), _make(std::forward<ARGS>(args)...));
+        }
+
+        template<typename ...ARGS>
+        T& emplace(iterator pos, ARGS&&... args)
+        {
+            return *insert(pos, _make(std::forward<ARGS>(args)...));
+        }
+
+        void push_back(T value)
+        {
+            insert(end(), _make(std::move(value)));
+        }
+
+        iterator insert(iterator pos, T value)
+        {
+            return insert(pos, _make(std::move(value)));
+        }
+
+        // links a detached node before pos
+        iterator insert(iterator pos, T *node)
+        {
+            assert(node->_ilist_prev == nullptr && node->_ilist_next == nullptr);
+
+            auto next = pos._node;
+            auto prev = next == nullptr ? _tail : next->_ilist_prev;
+
+            node->_ilist_prev = prev;
+            node->_ilist_next = next;
+            node->_ilist_parent = _owner;
+
+            if (prev == nullptr) { _head = node; } else { prev->_ilist_next = node; }
+            if (next == nullptr) { _tail = node; } else { next->_ilist_prev = node; }
+
+            ++_size;
+            return { node, this };
+        }
+
+        // unlinks a node without destroying it, so it can be inserted into
+        // another list
+        T* remove(T *node)
+        {
+            assert(node->_ilist_parent == _owner);
+
+            auto prev = node->_ilist_prev;
+            auto next = node->_ilist_next;
+
+            if (prev == nullptr) { _head = next; } else { prev->_ilist_next = next; }
+            if (next == nullptr) { _tail = prev; } else { next->_ilist_prev = prev; }
+
+            node->_ilist_prev = nullptr;
+            node->_ilist_next = nullptr;
+
+            --_size;
+            return node;
+        }
+
+        iterator erase(T *node)
+        {
+            auto next = node->_ilist_next;
+            remove(node)->~T();
+            return { next, this };
+        }
+
+        iterator erase(iterator pos)
+        {
+            return erase(pos._node);
+        }
+
+        void pop_back()
+        {
+            erase(_tail);
+        }
+
+        // moves a node from another list (possibly of another block) before pos
+        void splice(iterator pos, IList& other, T *node)
+        {
+            insert(pos, other.remove(node));
+        }
+
+        void clear()
+        {
+            while (_head != nullptr)
+            {
+                erase(_head);
+            }
+        }
+
+        Owner* owner() { return _owner; }
+
+    private:
+        Owner *_owner;
+        Arena *_arena;
+        T *_head{nullptr};
+        T *_tail{nullptr};
+        std::size_t _size{0};
+
+        template<typename ...ARGS>
+        T* _make(ARGS&&... args)
+        {
+            auto mem = _arena->allocate(sizeof(T), alignof(T));
+            return new (mem) T(std::forward<ARGS>(args)...);
+        }
+    };
+}
@@ -1,5 +1,6 @@
 #include <ucb/core/ir/instruction.hpp>
 
+#include <algorithm>
 #include <cassert>
 
 #include <ucb/core/ir/procedure.hpp>
@@ -7,74 +8,53 @@
 
 namespace ucb
 {
-    Operand::Operand(Procedure *parent):
-        _parent{parent},
-        _ty{T_VOID},
-        _kind{OperandKind::OK_POISON},
-        _is_def{false},
-        _reg{NO_REG},
-        _bblock_idx{-1},
-        _integer_val{0},
-        _unsigned_val{0},
-        _float_val{0}
-    {
-        assert(parent && "parent is null");
-    }
-
-    Operand::Operand(Procedure *parent, RegisterID reg, bool is_def):
-        Operand(parent)
+    Operand::Operand(RegisterID reg, TypeID ty, bool is_def)
     {
         assert(reg != NO_REG && "Virtual register is null");
         _kind = OperandKind::OK_VIRTUAL_REG;
-        auto r = _parent->get_register(reg);
-        assert(r && "Virtual register not found");
-        _ty = r->ty();
+        _set_ty(ty);
         _is_def = is_def;
         _reg = reg;
     }
 
-    Operand::Operand(Procedure *parent, int bblock_idx):
-        Operand(parent)
+    Operand::Operand(int bblock_idx)
     {
         assert(bblock_idx != -1 && "Basic Block is null");
         _kind = OperandKind::OK_BASIC_BLOCK;
-        _ty = T_STATIC_ADDRESS;
+        _set_ty(T_STATIC_ADDRESS);
         _bblock_idx = bblock_idx;
     }
 
-    Operand::Operand(Procedure *parent, long int val, TypeID ty):
-        Operand(parent)
+    Operand::Operand(long int val, TypeID ty)
     {
         assert(ty_is_signed_int(ty) && "expected an integer type");
         _kind = OperandKind::OK_INTEGER_CONST;
-        _ty = ty;
-        _integer_val = val; 
+        _set_ty(ty);
+        _integer_val = val;
     }
 
-    Operand::Operand(Procedure *parent, unsigned long val, TypeID ty):
-        Operand(parent)
+    Operand::Operand(unsigned long val, TypeID ty)
     {
         assert(ty_is_unsigned_int(ty) && "expected an unsigned integer type");
         _kind = OperandKind::OK_UNSIGNED_CONST;
-        _ty = ty;
-        _unsigned_val = val; 
+        _set_ty(ty);
+        _unsigned_val = val;
     }
 
-    Operand::Operand(Procedure *parent, double val, TypeID ty):
-        Operand(parent)
+    Operand::Operand(double val, TypeID ty)
     {
         assert(ty_is_float(ty) && "expected a float type");
         _kind = OperandKind::OK_FLOAT_CONST;
-        _ty = ty;
-        _float_val = val; 
+        _set_ty(ty);
+        _float_val = val;
     }
 
-    void Operand::dump(std::ostream& out)
+    void Operand::dump(std::ostream& out, Procedure& proc) const
     {
-        _parent->dump_ty(out, _ty);
+        proc.dump_ty(out, ty());
         out << " ";
 
-        switch (_kind)
+        switch (kind())
         {
             case OperandKind::OK_POISON:
                 out << "ERROR";
@@ -82,9 +62,9 @@ namespace ucb
 
             case OperandKind::OK_VIRTUAL_REG:
             {
-                auto r = _parent->get_register(_reg);
+                auto r = proc.get_register(_reg);
                 assert(r);
-                out << r->id();
+                out << proc.context()->symbols().name(r->id());
                 break;
             }
 
@@ -102,9 +82,9 @@ namespace ucb
 
             case OperandKind::OK_BASIC_BLOCK:
             {
-                auto bblock = _parent->get_bblock(_bblock_idx);
+                auto bblock = proc.get_bblock(_bblock_idx);
                 assert(bblock);
-                out << "%" << bblock->id();
+                out << "%" << bblock->name();
                 break;
             }
 
@@ -116,10 +96,71 @@ namespace ucb
         }
     }
 
+    Instruction::Instruction(BasicBlock *parent, InstrOpcode op, TypeID ty):
+        IListNode(parent),
+        _op{op},
+        _ty{ty},
+        _opnds(parent->parent()->arena())
+    {
+    }
+
+    Instruction::Instruction(BasicBlock *parent, InstrOpcode op, TypeID ty, SymbolID id):
+        Instruction(parent, op, ty)
+    {
+        _id = id;
+    }
+
+    Instruction::~Instruction()
+    {
+        for (auto& opnd: _opnds)
+        {
+            _unlink(opnd);
+        }
+    }
+
     void Instruction::add_operand(Operand opnd)
     {
-        assert(_parent->parent() == opnd.parent());
-        _opnds.push_back(std::move(opnd));
+        assert(opnd.kind() != OperandKind::OK_POISON);
+        _opnds.push_back(opnd);
+        _link(opnd);
+    }
+
+    void Instruction::set_operand(std::size_t idx, Operand opnd)
+    {
+        assert(opnd.kind() != OperandKind::OK_POISON);
+        _unlink(_opnds[idx]);
+        _opnds[idx] = opnd;
+        _link(opnd);
+    }
+
+    void Instruction::erase_from_parent()
+    {
+        parent()->insts().erase(this);
+    }
+
+    void Instruction::_link(const Operand& opnd)
+    {
+        auto vreg = parent()->parent()->get_register(opnd.get_virtual_reg());
+
+        if (vreg == nullptr) { return; }
+
+        auto& list = opnd.is_def() ? vreg->_defs : vreg->_uses;
+        list.push_back(this);
+    }
+
+    void Instruction::_unlink(const Operand& opnd)
+    {
+        auto vreg = parent()->parent()->get_register(opnd.get_virtual_reg());
+
+        if (vreg == nullptr) { return; }
+
+        // the order of the entries carries no meaning, blocks are mostly
+        // torn down front to back so the entry tends to be near the start
+        auto& list = opnd.is_def() ? vreg->_defs : vreg->_uses;
+        auto it = std::find(list.begin(), list.end(), this);
+        assert(it != list.end() && "operand missing from its register's def-use chain");
+        *it = list.back();
+        list.pop_back();
     }
 
     void Instruction::dump(std::ostream& out)
@@ -193,7 +234,7 @@ namespace ucb
                 break;
 
             case InstrOpcode::OP_CMP:
-                out << "cmp " << _id << "\t";
+                out << "cmp " << parent()->context()->symbols().name(_id) << "\t";
                 break;
 
             case InstrOpcode::OP_LOAD:
@@ -205,7 +246,11 @@ namespace ucb
                 break;
 
             case InstrOpcode::OP_CALL:
-                out << "call @" << _id << "\t";
+                out << "call @" << parent()->context()->symbols().name(_id) << "\t";
+                break;
+
+            case InstrOpcode::OP_PHI:
+                out << "phi\t";
                 break;
 
             default:
@@ -225,7 +270,7 @@ namespace ucb
         {
             out << j;
             j = ", ";
-            it->dump(out);
+            it->dump(out, *parent()->parent());
             it++;
         }
     }
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <cassert>
 #include <iterator>
 #include <ostream>
 #include <string>
 
+#include <ucb/core/arena.hpp>
+#include <ucb/core/small-vector.hpp>
+#include <ucb/core/ir/ilist.hpp>
 #include <ucb/core/ir/type.hpp>
 #include <ucb/core/ir/virtual-register.hpp>
 
@@ -23,38 +27,41 @@ namespace ucb
         OK_FRAME_SLOT
     };
 
+    // operands are kept inline on their instruction, so they carry no parent
+    // pointer and pack the type, kind and def flag next to a single payload
     class Operand
     {
     public:
         Operand() = default;
-        Operand(Procedure *parent, RegisterID reg, bool is_def);
-        Operand(Procedure *parent, int bblock_idx);
-        Operand(Procedure *parent, long int val, TypeID ty);
-        Operand(Procedure *parent, unsigned long val, TypeID ty);
-        Operand(Procedure *parent, double val, TypeID ty);
-
-        Procedure* parent() { return _parent; }
-        OperandKind kind() const { return _kind; }
-        TypeID ty() const { return _ty; }
+        Operand(RegisterID reg, TypeID ty, bool is_def);
+        explicit Operand(int bblock_idx);
+        Operand(long int val, TypeID ty);
+        Operand(unsigned long val, TypeID ty);
+        Operand(double val, TypeID ty);
+
+        OperandKind kind() const { return static_cast<OperandKind>(_kind); }
+        TypeID ty() const { return { _ty_val, _ty_size }; }
 
-        RegisterID get_virtual_reg() const { return _reg; }
+        RegisterID get_virtual_reg() const { return kind() == OperandKind::OK_VIRTUAL_REG ? _reg : NO_REG; }
         int get_bblock_idx() const { return _bblock_idx; }
         long int get_integer_val() const { return _integer_val; }
         unsigned long get_unsigned_val() const { return _unsigned_val; }
         double get_float_val() const { return _float_val; }
 
-        void dump(std::ostream& out);
+        void set_virtual_reg(RegisterID reg)
+        {
+            assert(kind() == OperandKind::OK_VIRTUAL_REG);
+            _reg = reg;
+        }
+
+        void dump(std::ostream& out, Procedure& proc) const;
 
         bool operator != (const Operand& other) const
         {
-            return _parent != other._parent
-                || _ty != other._ty
+            return _ty_val != other._ty_val
+                || _ty_size != other._ty_size
                 || _kind != other._kind
-                || _reg != other._reg
-                || _bblock_idx != other._bblock_idx
-                || _integer_val != other._integer_val
-                || _unsigned_val != other._unsigned_val
-                || _float_val != other._float_val;
+                || _raw != other._raw;
         }
 
         bool operator == (const Operand& other) const
@@ -62,24 +69,34 @@ namespace ucb
             return !(*this != other);
         }
 
-        bool is_def() { return _is_def; }
+        bool is_def() const { return _is_def; }
 
     private:
-        explicit Operand(Procedure *parent);
-
-        Procedure *_parent{nullptr};
-        TypeID _ty{T_ERROR};
-        OperandKind _kind{OperandKind::OK_POISON};
+        std::int64_t _ty_val : 49 {T_ERROR.val};
+        std::uint64_t _ty_size : 10 {T_ERROR.size};
+        std::uint64_t _kind : 4 {OperandKind::OK_POISON};
+        std::uint64_t _is_def : 1 {false};
 
-        bool _is_def{false};
-
-        RegisterID _reg{NO_REG};
-        int _bblock_idx{-1};
-        long int _integer_val{0};
-        unsigned long _unsigned_val{0};
-        double _float_val{0};
+        union
+        {
+            std::uint64_t _raw{0};
+            RegisterID _reg;
+            std::int64_t _bblock_idx;
+            long int _integer_val;
+            unsigned long _unsigned_val;
+            double _float_val;
+        };
+
+        void _set_ty(TypeID ty)
+        {
+            _ty_val = ty.val;
+            _ty_size = ty.size;
+            assert(_ty_val == ty.val && "type id does not fit in an operand");
+        }
     };
 
+    static_assert(sizeof(Operand) <= 16, "operands must stay compact");
+
     enum InstrOpcode
     {
         OP_NONE = 0,
@@ -103,36 +120,43 @@ namespace ucb
         OP_STORE,
         OP_CP,
         OP_CALL,
-        OP_RET
+        OP_RET,
+        // def followed by a value and basic block pair per incoming edge.
+        // only exists between mem2reg and out of ssa, ISel never sees it
+        OP_PHI
     };
 
-    class Instruction
+    class Instruction : public IListNode<Instruction, BasicBlock>
     {
     public:
-        Instruction(BasicBlock *parent, InstrOpcode op, TypeID ty):
-            _parent(parent),
-            _op{op},
-            _ty{ty}
-        {
-        }
+        // most instructions have a def and at most two uses
+        using OperandList = SmallVector<Operand, 3>;
 
-        Instruction(BasicBlock *parent, InstrOpcode op, TypeID ty, std::string id):
-            Instruction(parent, op, ty)
-        {
-            _id = std::move(id);
-        }
+        Instruction(BasicBlock *parent, InstrOpcode op, TypeID ty);
+        Instruction(BasicBlock *parent, InstrOpcode op, TypeID ty, SymbolID id);
+        // a copy would share the def-use entries of the original
+        Instruction(const Instruction&) = delete;
+        Instruction& operator = (const Instruction&) = delete;
+        // drops the operands from their registers' def-use chains
+        ~Instruction();
 
         std::string dump();
         void verify();
 
-        BasicBlock* parent() { return _parent; }
-        const BasicBlock* parent() const { return _parent; }
         InstrOpcode op() const { return _op; }
         TypeID ty() const { return _ty; }
-        const std::string& id() const { return _id; }
+        // call target or cmp predicate
+        SymbolID id() const { return _id; }
 
+        // virtual register operands are linked into the register's uses
+        // or defs, operands are only changed through the calls below so the
+        // chains never go stale
         void add_operand(Operand opnd);
-        std::vector<Operand>& opnds() { return _opnds; }
+        void set_operand(std::size_t idx, Operand opnd);
+        const OperandList& opnds() const { return _opnds; }
+
+        // unlinks the instruction from its block and destroys it
+        void erase_from_parent();
 
         void dump(std::ostream& out);
 
@@ -155,12 +179,15 @@ namespace ucb
         }
 
     private:
-        BasicBlock *_parent;
+        friend Procedure;
+
         InstrOpcode _op;
         TypeID _ty;
-        std::string _id; // TODO use an operand
-        std::vector<Operand> _opnds;
+        SymbolID _id{NO_SYMBOL}; // TODO use an operand
+        OperandList _opnds;
 
         void _dump_opnds(std::ostream& out);
+        void _link(const Operand& opnd);
+        void _unlink(const Operand& opnd);
     };
 }
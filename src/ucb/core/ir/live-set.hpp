@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include <ucb/core/ir/virtual-register.hpp>
+
+namespace ucb
+{
+    // dense register set used by the liveness analysis, virtual registers are
+    // indexed by their vreg number (val - VREG_START) and physical registers
+    // live on a small fixed bitset since there are only VREG_START of them
+    class LiveSet
+    {
+    public:
+        LiveSet() = default;
+
+        explicit LiveSet(std::uint64_t vreg_count):
+            _vregs((vreg_count + 63) / 64, 0)
+        {
+        }
+
+        bool contains(RegisterID reg) const
+        {
+            if (is_physical_reg(reg))
+            {
+                return _pregs.test(reg.val);
+            }
+
+            auto idx = reg.val - VREG_START;
+            auto word = idx / 64;
+
+            return word < _vregs.size()
+                && (_vregs[word] & (std::uint64_t{1} << (idx % 64))) != 0;
+        }
+
+        void insert(RegisterID reg)
+        {
+            if (is_physical_reg(reg))
+            {
+                _pregs.set(reg.val);
+                return;
+            }
+
+            auto idx = reg.val - VREG_START;
+            auto word = idx / 64;
+
+            if (word >= _vregs.size())
+            {
+                _vregs.resize(word + 1, 0);
+            }
+
+            _vregs[word] |= std::uint64_t{1} << (idx % 64);
+        }
+
+        void erase(RegisterID reg)
+        {
+            if (is_physical_reg(reg))
+            {
+                _pregs.reset(reg.val);
+                return;
+            }
+
+            auto idx = reg.val - VREG_START;
+            auto word = idx / 64;
+
+            if (word < _vregs.size())
+            {
+                _vregs[word] &= ~(std::uint64_t{1} << (idx % 64));
+            }
+        }
+
+        // this |= other, returns true if any bit was added
+        bool merge(const LiveSet& other)
+        {
+            auto changed = (other._pregs & ~_pregs).any();
+            _pregs |= other._pregs;
+
+            if (other._vregs.size() > _vregs.size())
+            {
+                _vregs.resize(other._vregs.size(), 0);
+            }
+
+            for (std::size_t i = 0; i < other._vregs.size(); ++i)
+            {
+                auto w = _vregs[i] | other._vregs[i];
+                changed = changed || w != _vregs[i];
+                _vregs[i] = w;
+            }
+
+            return changed;
+        }
+
+        // this = gen | (out & ~kill)
+        void assign_transfer(const LiveSet& gen, const LiveSet& out, const LiveSet& kill)
+        {
+            _pregs = gen._pregs | (out._pregs & ~kill._pregs);
+            _vregs.assign(std::max(gen._vregs.size(), out._vregs.size()), 0);
+
+            for (std::size_t i = 0; i < _vregs.size(); ++i)
+            {
+                auto g = i < gen._vregs.size() ? gen._vregs[i] : 0;
+                auto o = i < out._vregs.size() ? out._vregs[i] : 0;
+                auto k = i < kill._vregs.size() ? kill._vregs[i] : 0;
+                _vregs[i] = g | (o & ~k);
+            }
+        }
+
+        void clear()
+        {
+            _pregs.reset();
+            std::fill(_vregs.begin(), _vregs.end(), 0);
+        }
+
+        bool empty() const
+        {
+            if (_pregs.any()) { return false; }
+
+            for (auto w: _vregs)
+            {
+                if (w != 0) { return false; }
+            }
+
+            return true;
+        }
+
+        bool operator == (const LiveSet& other) const
+        {
+            if (_pregs != other._pregs) { return false; }
+
+            auto n = std::max(_vregs.size(), other._vregs.size());
+
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                auto a = i < _vregs.size() ? _vregs[i] : 0;
+                auto b = i < other._vregs.size() ? other._vregs[i] : 0;
+
+                if (a != b) { return false; }
+            }
+
+            return true;
+        }
+
+        // calls f with the register number (RegisterID::val) of every member
+        // in ascending order
+        template<typename F>
+        void for_each(F f) const
+        {
+            for (std::uint64_t i = 0; i < VREG_START; ++i)
+            {
+                if (_pregs.test(i)) { f(i); }
+            }
+
+            for (std::size_t i = 0; i < _vregs.size(); ++i)
+            {
+                auto w = _vregs[i];
+
+                while (w != 0)
+                {
+                    auto bit = std::countr_zero(w);
+                    f(VREG_START + i * 64 + bit);
+                    w &= w - 1;
+                }
+            }
+        }
+
+    private:
+        std::bitset<VREG_START> _pregs;
+        std::vector<std::uint64_t> _vregs;
+    };
+}
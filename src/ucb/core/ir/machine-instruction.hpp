@@ -4,10 +4,12 @@
 #include <string>
 #include <vector>
 
+#include <ucb/core/ir/ilist.hpp>
 #include <ucb/core/ir/type.hpp>
 
 namespace ucb
 {
+    class BasicBlock;
     class Procedure;
 
     struct MachineOperand
@@ -30,12 +32,12 @@ namespace ucb
         bool is_use{true};
     };
 
-    struct MachineInstruction
+    struct MachineInstruction : public IListNode<MachineInstruction, BasicBlock>
     {
         MachineOpc opc;
         std::int32_t size{0};
         std::vector<MachineOperand> opnds;
-        std::string id;
+        SymbolID id{NO_SYMBOL};
 
         MachineInstruction() = default;
 
@@ -44,9 +46,9 @@ namespace ucb
         {
         }
 
-        MachineInstruction(MachineOpc opc_, std::string id_):
+        MachineInstruction(MachineOpc opc_, SymbolID id_):
             opc{opc_},
-            id(std::move(id_))
+            id(id_)
         {
         }
     };
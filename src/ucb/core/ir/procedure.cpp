@@ -1,18 +1,24 @@
 #include <ucb/core/ir/procedure.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <deque>
+#include <utility>
 
 namespace ucb
 {
-    int Procedure::find_bblock(const std::string& id)
+    std::string_view Procedure::name()
     {
-        auto it = std::find_if(_bblocks.begin(), _bblocks.end(), [&](auto& b) {
-            return b.id() == id;
-        });
+        return _parent->symbols().name(_id);
+    }
+
+    int Procedure::find_bblock(SymbolID id)
+    {
+        auto it = _bblock_ids.find(id);
 
-        if (it != _bblocks.end())
+        if (it != _bblock_ids.end())
         {
-            return std::distance(_bblocks.begin(), it);
+            return it->second;
         }
 
         return -1;
@@ -24,7 +30,7 @@ namespace ucb
         return &_bblocks[idx];
     }
 
-    int Procedure::add_bblock(std::string id)
+    int Procedure::add_bblock(SymbolID id)
     {
         auto idx = find_bblock(id);
 
@@ -34,8 +40,10 @@ namespace ucb
         }
         else
         {
-            _bblocks.emplace_back(this, std::move(id));
-            return _bblocks.size() - 1;
+            idx = _bblocks.size();
+            _bblock_ids.emplace(id, idx);
+            _bblocks.emplace_back(this, id, idx);
+            return idx;
         }
     }
 
@@ -46,20 +54,24 @@ namespace ucb
             bblock.clear_dataflow();
         }
 
+        auto size = _bblocks.size();
+
+        _succ_offsets.assign(size + 1, 0);
+        _succ_idxs.clear();
+        _pred_offsets.assign(size + 1, 0);
+
         for (auto& bblock: _bblocks)
         {
             auto& terminator = bblock.insts().back();
             auto& opnds = terminator.opnds();
 
-            auto add_successor = [&](Operand& opnd)
+            auto add_successor = [&](const Operand& opnd)
             {
                 assert(opnd.kind() == OperandKind::OK_BASIC_BLOCK);
+                assert(static_cast<std::size_t>(opnd.get_bblock_idx()) < size);
 
-                auto bb = get_bblock(opnd.get_bblock_idx());
-                assert(bb);
-
-                bblock.successors().push_back(bb);
-                bb->predecessors().push_back(&bblock);
+                _succ_idxs.push_back(opnd.get_bblock_idx());
+                ++_pred_offsets[opnd.get_bblock_idx() + 1];
             };
 
             switch (terminator.op())
@@ -79,199 +91,643 @@ namespace ucb
                 break; // no successors and the end of the procedure
 
             default:
-                std::cerr << "unexpected terminator on bblock " << bblock.id() << std::endl;
+                std::cerr << "unexpected terminator on bblock " << bblock.name() << std::endl;
                 abort();
             }
+
+            _succ_offsets[bblock.idx() + 1] = _succ_idxs.size();
+        }
+
+        // predecessors are the successor edges turned around, counted above
+        // and then placed in block order
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            _pred_offsets[i + 1] += _pred_offsets[i];
+        }
+
+        _pred_idxs.resize(_succ_idxs.size());
+        std::vector<std::uint32_t> fill(_pred_offsets.begin(), _pred_offsets.end() - 1);
+
+        for (std::uint32_t i = 0; i < size; ++i)
+        {
+            for (auto j = _succ_offsets[i]; j < _succ_offsets[i + 1]; ++j)
+            {
+                _pred_idxs[fill[_succ_idxs[j]]++] = i;
+            }
+        }
+
+        for (auto& bblock: _bblocks)
+        {
+            auto i = bblock.idx();
+
+            bblock._successors = std::span<const std::uint32_t>(_succ_idxs).subspan(_succ_offsets[i], _succ_offsets[i + 1] - _succ_offsets[i]);
+            bblock._predecessors = std::span<const std::uint32_t>(_pred_idxs).subspan(_pred_offsets[i], _pred_offsets[i + 1] - _pred_offsets[i]);
+        }
+
+        compute_loop_info();
+
+        BasicBlock::RegTyTable reg_tys;
+
+        for (auto& bblock: _bblocks)
+        {
+            bblock.compute_gen_kill(reg_tys);
+        }
+
+        _solve_liveness(reg_tys);
+    }
+
+    void Procedure::compute_machine_lifetimes()
+    {
+        BasicBlock::RegTyTable reg_tys;
+
+        for (auto& bblock: _bblocks)
+        {
+            bblock.clear_lifetimes();
+            bblock.compute_machine_gen_kill(reg_tys);
+        }
+
+        _solve_liveness(reg_tys);
+    }
+
+    std::vector<BasicBlock*> Procedure::reverse_post_order()
+    {
+        std::vector<BasicBlock*> post_order;
+        post_order.reserve(_bblocks.size());
+        std::vector<bool> visited(_bblocks.size(), false);
+        std::vector<std::pair<BasicBlock*, std::size_t>> stack;
+
+        auto visit = [&](BasicBlock *root)
+        {
+            visited[root->idx()] = true;
+            stack.emplace_back(root, 0);
+
+            while (!stack.empty())
+            {
+                auto& [bblock, next] = stack.back();
+
+                if (next < bblock->successors().size())
+                {
+                    auto succ = bblock->successors()[next++];
+
+                    if (!visited[succ->idx()])
+                    {
+                        visited[succ->idx()] = true;
+                        stack.emplace_back(succ, 0);
+                    }
+                }
+                else
+                {
+                    post_order.push_back(bblock);
+                    stack.pop_back();
+                }
+            }
+        };
+
+        // unreachable blocks still get an order so every pass sees them
+        for (auto& bblock: _bblocks)
+        {
+            if (!visited[bblock.idx()])
+            {
+                visit(&bblock);
+            }
         }
 
-        auto has_changes = true;
+        std::reverse(post_order.begin(), post_order.end());
+        return post_order;
+    }
+
+    void Procedure::compute_loop_info()
+    {
+        auto size = _bblocks.size();
+        _loops.clear();
+
+        for (auto& bblock: _bblocks)
+        {
+            bblock._idom = nullptr;
+            bblock._dom_children.clear();
+            bblock._loop = -1;
+            bblock._loop_depth = 0;
+            bblock._frequency = 0;
+        }
+
+        if (size == 0)
+        {
+            return;
+        }
+
+        // dominators as in Cooper, Harvey and Kennedy's "A Simple, Fast
+        // Dominance Algorithm", blocks are compared by their position in
+        // the reverse post order. blocks left without an idom here are
+        // unreachable from the entry
+        auto rpo = reverse_post_order();
+        std::vector<std::size_t> order(size);
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            order[rpo[i]->idx()] = i;
+        }
+
+        std::vector<BasicBlock*> idoms(size, nullptr);
+        idoms[0] = &_bblocks[0];
 
-        while (has_changes)
+        auto intersect = [&](BasicBlock *a, BasicBlock *b)
         {
-            has_changes = false;
+            while (a != b)
+            {
+                while (order[a->idx()] > order[b->idx()]) { a = idoms[a->idx()]; }
+                while (order[b->idx()] > order[a->idx()]) { b = idoms[b->idx()]; }
+            }
+
+            return a;
+        };
+
+        auto changed = true;
 
-            for (auto& bblock: _bblocks)
+        while (changed)
+        {
+            changed = false;
+
+            for (auto bblock: rpo)
             {
-                if (bblock.compute_live_ins())
+                if (bblock->idx() == 0) { continue; }
+
+                BasicBlock *idom = nullptr;
+
+                for (auto pred: bblock->predecessors())
                 {
-                    has_changes = true;
+                    if (idoms[pred->idx()] != nullptr)
+                    {
+                        idom = idom != nullptr ? intersect(pred, idom) : pred;
+                    }
                 }
+
+                if (idoms[bblock->idx()] != idom)
+                {
+                    idoms[bblock->idx()] = idom;
+                    changed = true;
+                }
+            }
+        }
+
+        for (std::size_t i = 1; i < size; ++i)
+        {
+            if (idoms[i] != nullptr)
+            {
+                _bblocks[i]._idom = idoms[i];
+                idoms[i]->_dom_children.push_back(&_bblocks[i]);
+            }
+        }
+
+        // natural loops, an edge into a block that dominates its source is
+        // a back edge and all back edges to a header make up one loop
+        std::vector<int> header_loops(size, -1);
+        std::vector<std::vector<BasicBlock*>> latches;
+
+        for (auto bblock: rpo)
+        {
+            if (idoms[bblock->idx()] == nullptr) { continue; }
+
+            for (auto succ: bblock->successors())
+            {
+                if (!dominates(succ, bblock)) { continue; }
+
+                auto& loop = header_loops[succ->idx()];
+
+                if (loop == -1)
+                {
+                    loop = _loops.size();
+                    _loops.push_back({ .header = succ, .blocks = { succ }, .parent = -1, .depth = 1 });
+                    latches.emplace_back();
+                }
+
+                latches[loop].push_back(bblock);
+            }
+        }
+
+        std::vector<std::size_t> marks(size, SIZE_MAX);
+
+        for (std::size_t i = 0; i < _loops.size(); ++i)
+        {
+            auto& loop = _loops[i];
+            auto work = latches[i];
+            marks[loop.header->idx()] = i;
+
+            while (!work.empty())
+            {
+                auto bblock = work.back();
+                work.pop_back();
+
+                if (marks[bblock->idx()] == i) { continue; }
+
+                marks[bblock->idx()] = i;
+                loop.blocks.push_back(bblock);
+
+                for (auto pred: bblock->predecessors())
+                {
+                    if (idoms[pred->idx()] != nullptr)
+                    {
+                        work.push_back(pred);
+                    }
+                }
+            }
+        }
+
+        // outer loops first. a loop is nested in every loop holding its
+        // header, and the smallest of those is its parent
+        std::stable_sort(_loops.begin(), _loops.end(), [](auto& a, auto& b)
+        {
+            return a.blocks.size() > b.blocks.size();
+        });
+
+        for (std::size_t i = 0; i < _loops.size(); ++i)
+        {
+            auto& loop = _loops[i];
+            loop.parent = loop.header->_loop;
+            loop.depth = loop.parent == -1 ? 1 : _loops[loop.parent].depth + 1;
+
+            for (auto bblock: loop.blocks)
+            {
+                bblock->_loop = static_cast<int>(i);
+                bblock->_loop_depth = loop.depth;
             }
         }
 
+        auto in_loop = [&](BasicBlock *bblock, int loop)
+        {
+            for (auto l = bblock->_loop; l != -1; l = _loops[l].parent)
+            {
+                if (l == loop) { return true; }
+            }
+
+            return false;
+        };
+
+        // outermost loop an edge leaves, -1 when it stays inside
+        auto exited_loop = [&](BasicBlock *from, BasicBlock *to)
+        {
+            auto res = -1;
+
+            for (auto l = from->_loop; l != -1 && !in_loop(to, l); l = _loops[l].parent)
+            {
+                res = l;
+            }
+
+            return res;
+        };
+
+        std::vector<int> exits(_loops.size(), 0);
+
         for (auto& bblock: _bblocks)
         {
-            bblock.compute_live_outs();
+            for (auto succ: bblock.successors())
+            {
+                auto l = exited_loop(&bblock, succ);
+
+                if (l != -1)
+                {
+                    ++exits[l];
+                }
+            }
+        }
+
+        // static frequencies. every loop is assumed to run LOOP_TRIPS times
+        // per entry, a branch splits a block's weight evenly among the
+        // successors that stay in its loop and all that entered a loop
+        // leaves it evenly through its exits. back edges and the retreating
+        // edges of irreducible regions carry nothing
+        constexpr float LOOP_TRIPS = 10;
+        std::vector<float> weights(size, 0);
+        weights[0] = 1;
+
+        for (auto bblock: rpo)
+        {
+            auto idx = bblock->idx();
+
+            if (idoms[idx] == nullptr) { continue; }
+
+            auto stays = 0;
+
+            for (auto succ: bblock->successors())
+            {
+                if (order[succ->idx()] > order[idx] && exited_loop(bblock, succ) == -1)
+                {
+                    ++stays;
+                }
+            }
+
+            for (auto succ: bblock->successors())
+            {
+                if (order[succ->idx()] <= order[idx]) { continue; }
+
+                auto l = exited_loop(bblock, succ);
+
+                weights[succ->idx()] += l == -1
+                    ? weights[idx] / stays
+                    : weights[_loops[l].header->idx()] / exits[l];
+            }
+
+            bblock->_frequency = weights[idx] * std::pow(LOOP_TRIPS, bblock->_loop_depth);
         }
     }
 
-    void Procedure::compute_machine_lifetimes()
+    bool Procedure::dominates(BasicBlock *a, BasicBlock *b)
     {
+        for (auto bblock = b; bblock != nullptr; bblock = bblock->_idom)
+        {
+            if (bblock == a)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::vector<std::vector<BasicBlock*>> Procedure::dominance_frontiers()
+    {
+        std::vector<std::vector<BasicBlock*>> frontiers(_bblocks.size());
+
+        // walks up from each predecessor of a join point to its idom, the
+        // entry also joins the edge the procedure is called through
         for (auto& bblock: _bblocks)
         {
-            bblock.clear_lifetimes();
+            auto preds = bblock.predecessors();
+            auto is_entry = bblock.idx() == 0;
+
+            if (preds.size() < 2 && !(is_entry && preds.size() > 0))
+            {
+                continue;
+            }
+
+            if (!is_entry && bblock._idom == nullptr)
+            {
+                continue;
+            }
+
+            for (auto pred: preds)
+            {
+                if (pred->idx() != 0 && pred->_idom == nullptr)
+                {
+                    continue;
+                }
+
+                for (auto runner = pred; runner != nullptr && runner != bblock._idom; runner = runner->_idom)
+                {
+                    auto& frontier = frontiers[runner->idx()];
+
+                    if (std::find(frontier.begin(), frontier.end(), &bblock) == frontier.end())
+                    {
+                        frontier.push_back(&bblock);
+                    }
+                }
+            }
         }
 
-        auto has_changes = true;
+        return frontiers;
+    }
 
-        while (has_changes)
+    void Procedure::_solve_liveness(const BasicBlock::RegTyTable& reg_tys)
+    {
+        // liveness flows backwards, so seed the worklist in post order (the
+        // reverse post order of the reversed cfg) to visit successors first
+        auto rpo = reverse_post_order();
+        std::deque<BasicBlock*> worklist(rpo.rbegin(), rpo.rend());
+        std::vector<bool> in_worklist(_bblocks.size(), true);
+
+        while (!worklist.empty())
         {
-            has_changes = false;
+            auto bblock = worklist.front();
+            worklist.pop_front();
+            in_worklist[bblock->idx()] = false;
 
-            for (auto& bblock: _bblocks)
+            if (bblock->update_liveness())
             {
-                if (bblock.compute_machine_live_ins())
+                for (auto pred: bblock->predecessors())
                 {
-                    has_changes = true;
+                    auto idx = pred->idx();
+
+                    if (!in_worklist[idx])
+                    {
+                        in_worklist[idx] = true;
+                        worklist.push_back(pred);
+                    }
                 }
             }
         }
 
         for (auto& bblock: _bblocks)
         {
-            bblock.compute_live_outs();
+            bblock.build_live_lists(reg_tys);
         }
     }
 
-    Operand Procedure::operand_from_bblock(const std::string& id)
+    Operand Procedure::operand_from_bblock(SymbolID id)
     {
         auto idx = find_bblock(id);
 
         if (idx == -1)
         {
-            std::cerr << "basic block \"" << id << "\" not found\n";
+            std::cerr << "basic block \"" << _parent->symbols().name(id) << "\" not found\n";
             return Operand();
         }
         else
         {
-            return Operand(this, idx);
+            return Operand(idx);
         }
     }
 
-    RegisterID Procedure::find_vreg(const std::string& id)
+    RegisterID Procedure::find_vreg(SymbolID id)
     {
-        auto it = std::find_if(_regs.begin(), _regs.end(), [&](auto& r) {
-            return r.second.id() == id;
-        });
+        auto it = _vreg_ids.find(id);
 
-        if (it != _regs.end())
+        if (it != _vreg_ids.end())
         {
-            return it->first;
+            return it->second;
         }
 
-        it = std::find_if(_frame.begin(), _frame.end(), [&](auto& r) {
-            return r.second.id() == id;
-        });
+        return NO_REG;
+    }
+
+    VirtualRegister* Procedure::get_register(RegisterID id)
+    {
+        return const_cast<VirtualRegister*>(std::as_const(*this).get_register(id));
+    }
+
+    const VirtualRegister* Procedure::get_register(RegisterID id) const
+    {
+        auto slot = _find_slot(id);
+        return slot != nullptr ? &slot->second : nullptr;
+    }
 
-        if (it != _frame.end())
+    bool Procedure::is_param(RegisterID id) const
+    {
+        return _find_slot(id) != nullptr
+            && _vreg_slots[id.val - VREG_START].kind == RegSlotKind::RSK_PARAM;
+    }
+
+    bool Procedure::is_frame_slot(RegisterID id) const
+    {
+        return _find_slot(id) != nullptr
+            && _vreg_slots[id.val - VREG_START].kind == RegSlotKind::RSK_FRAME;
+    }
+
+    const Procedure::RegSlot* Procedure::_find_slot(RegisterID id) const
+    {
+        if (is_physical_reg(id) || id.val - VREG_START >= _vreg_slots.size())
         {
-            return it->first;
+            return nullptr;
         }
 
-        it = std::find_if(_params.begin(), _params.end(), [&](auto& r) {
-            return r.second.id() == id;
-        });
+        auto [kind, idx] = _vreg_slots[id.val - VREG_START];
+        const RegSlot *slot = nullptr;
 
-        if (it != _params.end())
+        if (idx == REMOVED_SLOT)
         {
-            return it->first;
+            return nullptr;
         }
 
-        return NO_REG;
-    }
+        switch (kind)
+        {
+        case RegSlotKind::RSK_PARAM:
+            slot = &_params[idx];
+            break;
 
-    const VirtualRegister* Procedure::get_register(RegisterID id) const
-    {
-        auto it = std::find_if(_regs.begin(), _regs.end(), [&](auto& r) {
-            return r.first == id;
-        });
+        case RegSlotKind::RSK_FRAME:
+            slot = &_frame[idx];
+            break;
+
+        case RegSlotKind::RSK_REG:
+            slot = &_regs[idx];
+            break;
+        }
 
-        if (it != _regs.end())
+        if (slot->first != id)
         {
-            return &it->second;
+            return nullptr;
         }
 
-        it = std::find_if(_frame.begin(), _frame.end(), [&](auto& r) {
-            return r.first == id;
-        });
+        return slot;
+    }
+
+    void Procedure::replace_all_uses_with(RegisterID from, const Operand& to)
+    {
+        auto vreg = get_register(from);
+        assert(vreg);
+
+        auto to_vreg = get_register(to.get_virtual_reg());
+        auto opnd_to = to_vreg != nullptr ? Operand(to.get_virtual_reg(), to.ty(), false) : to;
+        auto uses = std::move(vreg->_uses);
+        vreg->_uses.clear();
 
-        if (it != _frame.end())
+        for (auto inst: uses)
         {
-            return &it->second;
+            // an instruction reading the register twice shows up once per
+            // operand, the first visit rewrites all of them
+            for (auto& opnd: inst->_opnds)
+            {
+                if (opnd.is_def() || opnd.get_virtual_reg() != from) { continue; }
+
+                opnd = opnd_to;
+
+                if (to_vreg != nullptr)
+                {
+                    to_vreg->_uses.push_back(inst);
+                }
+            }
         }
+    }
 
-        it = std::find_if(_params.begin(), _params.end(), [&](auto& r) {
-            return r.first == id;
-        });
+    void Procedure::_index_vreg(SymbolID id, RegisterID rid, RegSlotKind kind, std::size_t idx)
+    {
+        _vreg_ids.emplace(id, rid);
+
+        auto dense = rid.val - VREG_START;
 
-        if (it != _params.end())
+        if (dense >= _vreg_slots.size())
         {
-            return &it->second;
+            _vreg_slots.resize(dense + 1);
         }
 
-        return nullptr;
+        _vreg_slots[dense] = { kind, static_cast<std::uint32_t>(idx) };
     }
 
-    RegisterID Procedure::add_frame_slot(std::string id, TypeID ty)
+    RegisterID Procedure::add_frame_slot(SymbolID id, TypeID ty)
     {
         auto rid = find_vreg(id);
 
         if (rid != NO_REG)
         {
-            std::cerr << "virtual register \"" << id << "\" already exists\n";
+            std::cerr << "virtual register \"" << _parent->symbols().name(id) << "\" already exists\n";
             return NO_REG;
         }
         else
         {
             rid = { _next_vreg++, ty.size };
-            _frame.emplace_back(rid, VirtualRegister(this, std::move(id), ty));
+            _index_vreg(id, rid, RegSlotKind::RSK_FRAME, _frame.size());
+            _frame.emplace_back(rid, VirtualRegister(this, id, ty));
             return rid;
         }
     }
 
-    RegisterID Procedure::add_vreg(std::string id, TypeID ty)
+    void Procedure::remove_frame_slot(RegisterID id)
+    {
+        assert(is_frame_slot(id));
+
+        auto idx = _vreg_slots[id.val - VREG_START].idx;
+        _vreg_ids.erase(_frame[idx].second.id());
+        _frame.erase(_frame.begin() + idx);
+        _vreg_slots[id.val - VREG_START].idx = REMOVED_SLOT;
+
+        for (auto i = idx; i < _frame.size(); ++i)
+        {
+            _vreg_slots[_frame[i].first.val - VREG_START].idx = i;
+        }
+    }
+
+    RegisterID Procedure::add_vreg(SymbolID id, TypeID ty)
     {
         auto rid = find_vreg(id);
 
         if (rid != NO_REG)
         {
-            std::cerr << "virtual register \"" << id << "\" already exists\n";
+            std::cerr << "virtual register \"" << _parent->symbols().name(id) << "\" already exists\n";
             return NO_REG;
         }
         else
         {
             rid = { _next_vreg++, ty.size };
-            _regs.emplace_back(rid, VirtualRegister(this, std::move(id), ty));
+            _index_vreg(id, rid, RegSlotKind::RSK_REG, _regs.size());
+            _regs.emplace_back(rid, VirtualRegister(this, id, ty));
             return rid;
         }
     }
 
-    Operand Procedure::operand_from_vreg(const std::string& id, bool is_def)
+    Operand Procedure::operand_from_vreg(SymbolID id, bool is_def)
     {
         auto rid = find_vreg(id);
 
         if (rid == NO_REG)
         {
-            std::cerr << "virtual register \"" << id << "\" not found\n";
+            std::cerr << "virtual register \"" << _parent->symbols().name(id) << "\" not found\n";
             return Operand();
         }
         else
         {
-            return Operand(this, rid, is_def);
+            return Operand(rid, get_register(rid)->ty(), is_def);
         }
     }
 
     void Procedure::dump(std::ostream& out)
     {
         _parent->dump_ty(out, _signature.ret());
-        out << " @" << _id << "(";
+        out << " @" << name() << "(";
         auto junc = "";
 
         for (auto& arg: _signature.args())
         {
             out << junc;
             _parent->dump_ty(out, arg.second);
-            out << " " << arg.first;
+            out << " " << _parent->symbols().name(arg.first);
             junc = ", ";
         }
 
@@ -285,7 +741,7 @@ namespace ucb
             {
                 out << "\t";
                 _parent->dump_ty(out, reg.second.ty());
-                out << " " << reg.second.id() << "\n";
+                out << " " << _parent->symbols().name(reg.second.id()) << "\n";
             }
 
             out << "\n";
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <ostream>
+#include <unordered_map>
 #include <vector>
 
 #include <ucb/core/ir/compile-unit.hpp>
@@ -10,23 +12,35 @@
 
 namespace ucb
 {
+    struct Loop
+    {
+        BasicBlock *header;
+        // the header first, then every block that reaches one of its back
+        // edges without going through it
+        std::vector<BasicBlock*> blocks;
+        // enclosing loop, -1 for an outermost one
+        int parent;
+        int depth;
+    };
+
     class Procedure
     {
     public:
-        Procedure(CompileUnit *parent, std::string id, ProcSignature signature):
+        Procedure(CompileUnit *parent, SymbolID id, ProcSignature signature):
             _parent{parent},
-            _id(std::move(id)),
+            _id(id),
             _signature(std::move(signature))
         {
-            _bblocks.reserve(100);
             for (auto& arg: _signature.args())
             {
                 RegisterID rid = { _next_vreg++, arg.second.size };
                 _params.emplace_back(rid, VirtualRegister{this, arg.first, arg.second});
+                _index_vreg(arg.first, rid, RegSlotKind::RSK_PARAM, _params.size() - 1);
             }
         }
 
-        const std::string& id() const { return _id; }
+        SymbolID id() const { return _id; }
+        std::string_view name();
         const ProcSignature& signature() { return _signature; }
 
         using RegSlot = std::pair<RegisterID, VirtualRegister>;
@@ -41,34 +55,56 @@ namespace ucb
             return *_bblocks.begin();
         }
 
-        std::vector<BasicBlock>& bblocks()
+        std::deque<BasicBlock>& bblocks()
         {
             return _bblocks;
         }
 
-        int find_bblock(const std::string& id);
+        int find_bblock(SymbolID id);
         BasicBlock* get_bblock(int idx);
-        int add_bblock(std::string id);
+        int add_bblock(SymbolID id);
         void compute_predecessors();
         void compute_machine_lifetimes();
-        Operand operand_from_bblock(const std::string& id);
-
-        RegisterID find_vreg(const std::string& id);
+        std::vector<BasicBlock*> reverse_post_order();
+        // dominator tree, natural loops and static block frequencies, kept
+        // up to date by compute_predecessors
+        void compute_loop_info();
+        bool dominates(BasicBlock *a, BasicBlock *b);
+        // indexed like bblocks, needs compute_loop_info. unreachable blocks
+        // have an empty frontier
+        std::vector<std::vector<BasicBlock*>> dominance_frontiers();
+        std::vector<Loop>& loops() { return _loops; }
+        Operand operand_from_bblock(SymbolID id);
+
+        RegisterID find_vreg(SymbolID id);
+        VirtualRegister* get_register(RegisterID id);
         const VirtualRegister* get_register(RegisterID id) const;
-        RegisterID add_frame_slot(std::string id, TypeID ty);
-        RegisterID add_vreg(std::string id, TypeID ty);
-        Operand operand_from_vreg(const std::string& id, bool is_def);
+        bool is_param(RegisterID id) const;
+        bool is_frame_slot(RegisterID id) const;
+        RegisterID add_frame_slot(SymbolID id, TypeID ty);
+        // the slot must not be used anymore, later slots move down by one
+        void remove_frame_slot(RegisterID id);
+        RegisterID add_vreg(SymbolID id, TypeID ty);
+        Operand operand_from_vreg(SymbolID id, bool is_def);
+
+        // rewrites every operand reading from, to may be a register or a
+        // constant. the def-use chains are kept by the instructions
+        // themselves, see Instruction::add_operand
+        void replace_all_uses_with(RegisterID from, const Operand& to);
 
         CompileUnit* context() { return _parent; }
+        Arena* arena() { return &_arena; }
 
         void dump(std::ostream& out);
         void dump_ty(std::ostream& out, TypeID ty);
 
     private:
         CompileUnit *_parent;
+        // backs the procedure's instructions, must outlive everything below
+        Arena _arena;
 
         ProcSignature _signature;
-        std::string _id;
+        SymbolID _id;
 
         std::uint64_t _next_vreg{VREG_START};
 
@@ -76,6 +112,42 @@ namespace ucb
         std::vector<RegSlot> _frame;
         std::vector<RegSlot> _regs;
 
-        std::vector<BasicBlock> _bblocks;
+        enum RegSlotKind : std::uint8_t
+        {
+            RSK_PARAM,
+            RSK_FRAME,
+            RSK_REG
+        };
+
+        struct RegSlotRef
+        {
+            RegSlotKind kind;
+            std::uint32_t idx;
+        };
+
+        static constexpr std::uint32_t REMOVED_SLOT = UINT32_MAX;
+
+        // name -> register and register (val - VREG_START) -> slot indexes,
+        // kept in sync with _params, _frame and _regs
+        std::unordered_map<SymbolID, RegisterID> _vreg_ids;
+        std::vector<RegSlotRef> _vreg_slots;
+        std::unordered_map<SymbolID, int> _bblock_ids;
+
+        // cfg edges as block indexes, the edges of block i are
+        // [offsets[i], offsets[i + 1]). rebuilt by compute_predecessors
+        std::vector<std::uint32_t> _succ_offsets;
+        std::vector<std::uint32_t> _succ_idxs;
+        std::vector<std::uint32_t> _pred_offsets;
+        std::vector<std::uint32_t> _pred_idxs;
+
+        // destroyed first, instructions unlink their operands from the
+        // registers above on the way out. a deque so blocks never move as
+        // more are added, instructions and edges point at them
+        std::deque<BasicBlock> _bblocks;
+        std::vector<Loop> _loops;
+
+        const RegSlot* _find_slot(RegisterID id) const;
+        void _index_vreg(SymbolID id, RegisterID rid, RegSlotKind kind, std::size_t idx);
+        void _solve_liveness(const BasicBlock::RegTyTable& reg_tys);
     };
 }
@@ -0,0 +1,55 @@
+#include <ucb/core/ir/symbol.hpp>
+
+#include <mutex>
+
+namespace ucb
+{
+    SymbolTable::SymbolTable()
+    {
+        _names.emplace_back();
+        _ids.emplace(_names.back(), NO_SYMBOL);
+    }
+
+    SymbolID SymbolTable::intern(std::string_view name)
+    {
+        {
+            std::shared_lock lock(_mutex);
+            auto it = _ids.find(name);
+
+            if (it != _ids.end())
+            {
+                return it->second;
+            }
+        }
+
+        std::unique_lock lock(_mutex);
+
+        // someone else may have added it in between
+        auto it = _ids.find(name);
+
+        if (it != _ids.end())
+        {
+            return it->second;
+        }
+
+        SymbolID id = { static_cast<std::uint32_t>(_names.size()) };
+
+        // the key points at the owned copy, not at the caller's buffer
+        _names.emplace_back(name);
+        _ids.emplace(_names.back(), id);
+
+        return id;
+    }
+
+    std::string_view SymbolTable::name(SymbolID id) const
+    {
+        std::shared_lock lock(_mutex);
+        return _names[id.val];
+    }
+
+    std::size_t SymbolTable::size() const
+    {
+        std::shared_lock lock(_mutex);
+        return _names.size();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ucb
+{
+    // identifiers of the compile unit (procedures, registers, blocks, call
+    // targets and cmp predicates) are interned once, IR objects only keep
+    // the id and the text is looked up when printing
+    struct SymbolID
+    {
+        std::uint32_t val;
+
+        bool operator != (const SymbolID& other) const = default;
+        bool operator == (const SymbolID& other) const = default;
+    };
+
+    // the empty name
+    constexpr SymbolID NO_SYMBOL = { 0 };
+
+    class SymbolTable
+    {
+    public:
+        SymbolTable();
+
+        SymbolTable(const SymbolTable&) = delete;
+        SymbolTable& operator = (const SymbolTable&) = delete;
+
+        SymbolID intern(std::string_view name);
+        // the view stays valid for as long as the table
+        std::string_view name(SymbolID id) const;
+        // ids are dense, every id below size() is in the table
+        std::size_t size() const;
+
+    private:
+        // names live on a deque so the views handed out and the keys of
+        // _ids never move. procedures are compiled concurrently and may
+        // make up new names, lookups only take _mutex shared
+        mutable std::shared_mutex _mutex;
+        std::deque<std::string> _names;
+        std::unordered_map<std::string_view, SymbolID> _ids;
+    };
+}
+
+template<>
+struct std::hash<ucb::SymbolID>
+{
+    std::size_t operator () (ucb::SymbolID id) const
+    {
+        return std::hash<std::uint32_t>{}(id.val);
+    }
+};
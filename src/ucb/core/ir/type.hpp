@@ -4,6 +4,8 @@
 #include <iostream>
 #include <vector>
 
+#include <ucb/core/ir/symbol.hpp>
+
 namespace ucb
 {
     class CompileUnit;
@@ -45,7 +47,7 @@ namespace ucb
     constexpr TypeID T_F32 = { 5, 32 };
     constexpr TypeID T_F64 = { 5, 64 };
 
-    const TypeID T_SAME = { 6, 0 };
+    constexpr TypeID T_SAME = { 6, 0 };
 
     constexpr std::int64_t COMP_TY_START = 10;
 
@@ -121,11 +123,11 @@ namespace ucb
         }
 
         TypeID ret() const { return _ty; };
-        std::vector<std::pair<std::string, TypeID>>& args() { return _args; }
-        const std::vector<std::pair<std::string, TypeID>>& args() const { return _args; }
+        std::vector<std::pair<SymbolID, TypeID>>& args() { return _args; }
+        const std::vector<std::pair<SymbolID, TypeID>>& args() const { return _args; }
 
     private:
         TypeID _ty;
-        std::vector<std::pair<std::string, TypeID>> _args;
+        std::vector<std::pair<SymbolID, TypeID>> _args;
     };
 }
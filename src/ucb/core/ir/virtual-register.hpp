@@ -4,6 +4,7 @@
 #include <vector>
 #include <ostream>
 
+#include <ucb/core/ir/symbol.hpp>
 #include <ucb/core/ir/type.hpp>
 
 namespace ucb
@@ -46,21 +47,27 @@ namespace ucb
         friend Procedure;
         friend Instruction;
 
-        VirtualRegister(Procedure *parent, std::string id, TypeID ty):
+        VirtualRegister(Procedure *parent, SymbolID id, TypeID ty):
             _parent{parent},
-            _id{std::move(id)},
+            _id{id},
             _ty{ty}
         {
         }
 
         Procedure* parent() { return _parent; }
         const Procedure* parent() const { return _parent; }
-        const std::string& id() const { return _id; }
+        SymbolID id() const { return _id; }
         const TypeID ty() const { return _ty; }
 
+        // instructions reading and writing the register, one entry per
+        // operand, kept up to date by the instructions as operands are added,
+        // replaced or erased
+        const std::vector<Instruction*>& uses() const { return _uses; }
+        const std::vector<Instruction*>& defs() const { return _defs; }
+
     private:
         Procedure *_parent;
-        std::string _id;
+        SymbolID _id;
         TypeID _ty;
 
         std::vector<Instruction*> _uses;
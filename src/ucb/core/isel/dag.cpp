@@ -30,15 +30,16 @@ namespace ucb
             case InstrOpcode::OP_SHL: out << " = shl\n"; return;
             case InstrOpcode::OP_SHR: out << " = shr\n"; return;
             case InstrOpcode::OP_CAST: out << " = cast\n"; return;
-            case InstrOpcode::OP_CMP: out << " = cmp " << _id << "\n"; return;
+            case InstrOpcode::OP_CMP: out << " = cmp " << _name << "\n"; return;
             case InstrOpcode::OP_BR: out << " = br\n"; return;
             case InstrOpcode::OP_BRC: out << " = brc\n"; return;
             case InstrOpcode::OP_ALLOC: out << "alloc\n"; return;
             case InstrOpcode::OP_LOAD: out << " = load\n"; return;
             case InstrOpcode::OP_STORE: out << "store\n"; return;
             case InstrOpcode::OP_CP: out << " = cp\n"; return;
-            case InstrOpcode::OP_CALL: out << " = call " << _id << "\n"; return;
+            case InstrOpcode::OP_CALL: out << " = call " << _name << "\n"; return;
             case InstrOpcode::OP_RET: out << "ret\n"; return;
+            case InstrOpcode::OP_PHI: out << " = phi\n"; return;
             }
         };
 
@@ -92,7 +93,7 @@ namespace ucb
         }
     }
 
-    std::shared_ptr<DagNode> Dag::get_register(RegisterID id, TypeID ty)
+    DagNode* Dag::get_register(RegisterID id, TypeID ty)
     {
         // search from last to first in order to find the last def
         for (auto it = _all_nodes.rbegin(); it != _all_nodes.rend(); it++)
@@ -4,10 +4,13 @@
 #include <memory>
 #include <ostream>
 #include <set>
+#include <string_view>
 #include <vector>
 
+#include <ucb/core/arena.hpp>
 #include <ucb/core/ir/compile-unit.hpp>
 #include <ucb/core/ir/instruction.hpp>
+#include <ucb/core/ir/symbol.hpp>
 #include <ucb/core/ir/type.hpp>
 
 namespace ucb
@@ -23,17 +26,26 @@ namespace ucb
         DDK_EXIT,
     };
 
+    class DagNode;
+
+    using DagNodeList = std::vector<DagNode*, ArenaAllocator<DagNode*>>;
+
+    // dag nodes live on the isel scratch arena and are released all at once
+    // after the basic block is selected, so plain pointers are used
     class DagNode
     {
     public:
         friend class Dag;
 
-        DagNode(int og_order, InstrOpcode opc, DagDefKind kind, TypeID ty, std::string id):
+        DagNode(Arena *arena, int og_order, InstrOpcode opc, DagDefKind kind, TypeID ty, SymbolID id, std::string_view name):
             _og_order{og_order},
             _opc{opc},
             _kind{kind},
             _ty{ty},
-            _id(std::move(id))
+            _id{id},
+            _name{name},
+            _args(arena),
+            _selected_args(arena)
         {
         }
 
@@ -46,33 +58,31 @@ namespace ucb
         std::uint64_t& imm_val() { return _imm_val; }
         std::uint64_t& mem_id() { return _mem_id; }
         std::int64_t& bblock_idx() { return _bblock_idx; }
-        const std::string& id() const { return _id; }
+        SymbolID id() const { return _id; }
+        // text of id, the patterns name cmp predicates by their text
+        std::string_view name() const { return _name; }
         float& cost() { return _cost; }
         int& uses() { return _uses; }
 
-        std::vector<std::shared_ptr<DagNode>>& args() { return _args; }
-        std::vector<std::shared_ptr<DagNode>>& selected_args() { return _selected_args; }
+        DagNodeList& args() { return _args; }
+        DagNodeList& selected_args() { return _selected_args; }
         std::list<MachineInstruction>& selected_insts() { return _selected_insts; }
 
-        DagNode& add_arg(std::shared_ptr<DagNode> arg)
+        DagNode& add_arg(DagNode *arg)
         {
-            _args.push_back(std::move(arg));
+            _args.push_back(arg);
             return *this;
         }
 
-        DagNode& add_selected_arg(std::shared_ptr<DagNode> arg)
+        DagNode& add_selected_arg(DagNode *arg)
         {
-            _selected_args.push_back(std::move(arg));
+            _selected_args.push_back(arg);
             return *this;
         }
 
-        void add_selected_args(std::vector<std::shared_ptr<DagNode>> args)
+        void add_selected_args(const std::vector<DagNode*>& args)
         {
-            _selected_args.insert(
-                _selected_args.end(),
-                std::make_move_iterator(args.begin()),
-                std::make_move_iterator(args.end())
-            );
+            _selected_args.insert(_selected_args.end(), args.begin(), args.end());
         }
 
         void add_selected_insts(std::list<MachineInstruction> insts)
@@ -92,7 +102,8 @@ namespace ucb
         InstrOpcode _opc;
         DagDefKind _kind;
         TypeID _ty;
-        std::string _id;
+        SymbolID _id;
+        std::string_view _name;
 
         MachineOpc _mopc{MOP_NONE};
         RegisterID _reg{NO_REG};
@@ -104,8 +115,8 @@ namespace ucb
         float _cost{0};
         int _uses{0};
 
-        std::vector<std::shared_ptr<DagNode>> _args;
-        std::vector<std::shared_ptr<DagNode>> _selected_args;
+        DagNodeList _args;
+        DagNodeList _selected_args;
         std::list<MachineInstruction> _selected_insts;
     };
 
@@ -131,30 +142,44 @@ namespace ucb
     class Dag
     {
     public:
+        Dag(Arena *arena, const SymbolTable *symbols):
+            _arena{arena},
+            _symbols{symbols},
+            _all_nodes(arena),
+            _root_nodes(arena)
+        {
+        }
+
         // std::shared_ptr<DagNode> entry() { return _entry; }
         // std::shared_ptr<DagNode> exit() { return _exit; }
 
-        std::shared_ptr<DagNode> get_register(RegisterID id, TypeID ty);
-        //std::shared_ptr<DagNode> get_int_imm(long int val, TypeID ty);
-        //std::shared_ptr<DagNode> get_uint_imm(unsigned long val, TypeID ty);
-        //std::shared_ptr<DagNode> get_float_imm(double val, TypeID ty);
+        DagNode* make_node(int og_order, InstrOpcode opc, DagDefKind kind, TypeID ty, SymbolID id = NO_SYMBOL)
+        {
+            auto name = id == NO_SYMBOL ? std::string_view() : _symbols->name(id);
+            return _arena->make<DagNode>(_arena, og_order, opc, kind, ty, id, name);
+        }
+
+        DagNode* get_register(RegisterID id, TypeID ty);
+        //DagNode* get_int_imm(long int val, TypeID ty);
+        //DagNode* get_uint_imm(unsigned long val, TypeID ty);
+        //DagNode* get_float_imm(double val, TypeID ty);
 
         template<typename T>
-        std::shared_ptr<DagNode> get_imm(T val, TypeID ty)
+        DagNode* get_imm(T val, TypeID ty)
         {
-            auto n = std::make_shared<DagNode>(-1, InstrOpcode::OP_NONE, DagDefKind::DDK_IMM, ty, "");
+            auto n = make_node(-1, InstrOpcode::OP_NONE, DagDefKind::DDK_IMM, ty);
             n->_imm_val = std::bit_cast<std::uint64_t>(val);
             return n;
         }
 
-        std::shared_ptr<DagNode> get_addr(int bblock_idx)
+        DagNode* get_addr(int bblock_idx)
         {
-            auto n = std::make_shared<DagNode>(-1, InstrOpcode::OP_NONE, DagDefKind::DDK_ADDR, T_STATIC_ADDRESS, "");
+            auto n = make_node(-1, InstrOpcode::OP_NONE, DagDefKind::DDK_ADDR, T_STATIC_ADDRESS);
             n->_bblock_idx = bblock_idx;
             return n;
         }
 
-        void add_def(std::shared_ptr<DagNode> def)
+        void add_def(DagNode *def)
         {
             _all_nodes.push_back(def);
 
@@ -162,7 +187,7 @@ namespace ucb
             {
                 if (++arg->uses() > 1)
                 {
-                    auto it = std::find(_root_nodes.begin(), _root_nodes.end(), def);
+                    auto it = std::find(_root_nodes.begin(), _root_nodes.end(), arg);
 
                     if (it == _root_nodes.end())
                     {
@@ -172,13 +197,13 @@ namespace ucb
             }
         }
 
-        void add_root_def(std::shared_ptr<DagNode> def)
+        void add_root_def(DagNode *def)
         {
             _root_nodes.push_back(def);
-            add_def(std::move(def));
+            add_def(def);
         }
 
-        std::vector<std::shared_ptr<DagNode>>& root_nodes() { return _root_nodes; }
+        DagNodeList& root_nodes() { return _root_nodes; }
 
         void dump(std::ostream& out, CompileUnit& context);
 
@@ -186,8 +211,10 @@ namespace ucb
         // std::shared_ptr<DagNode> _entry;
         // std::shared_ptr<DagNode> _exit;
 
-        std::vector<std::shared_ptr<DagNode>> _all_nodes;
-        std::vector<std::shared_ptr<DagNode>> _root_nodes;
+        Arena *_arena;
+        const SymbolTable *_symbols;
+        DagNodeList _all_nodes;
+        DagNodeList _root_nodes;
 
         std::vector<DagMem> _mems;
     };
@@ -8,14 +8,18 @@ namespace ucb
     {
         if (debug)
         {
-            std::cout << "instruction selection for procedure: " << proc->id() << "\n\n";
+            std::cout << "instruction selection for procedure: " << proc->name() << "\n\n";
         }
 
         proc->compute_predecessors();
 
+        // dag nodes are dropped after every block, the scratch arena is kept
+        // per call so several procedures can be selected at once
+        Arena scratch;
+
         for (auto& bblock: proc->bblocks())
         {
-            run_on_bblock(bblock, debug);
+            run_on_bblock(bblock, scratch, debug);
         }
 
         _target->abi_lower(*proc);
@@ -23,7 +27,7 @@ namespace ucb
 
         if (debug)
         {
-            std::cout << "proc \"" << proc->id() << "\" after instruction selection:\n\n";
+            std::cout << "proc \"" << proc->name() << "\" after instruction selection:\n\n";
 
             for (auto& bblock: proc->bblocks())
             {
@@ -32,7 +36,7 @@ namespace ucb
         }
     }
 
-    void DynamicISel::run_on_bblock(BasicBlock& bblock, bool debug)
+    void DynamicISel::run_on_bblock(BasicBlock& bblock, Arena& scratch, bool debug)
     {
         if (debug)
         {
@@ -41,8 +45,9 @@ namespace ucb
             std::cout << std::endl;
         }
 
-        // build dag
-        Dag dag;
+        // build dag, every node lives on the scratch arena which is released
+        // once the block is selected
+        Dag dag(&scratch, &bblock.context()->symbols());
         int order = 0;
 
         std::vector<RegisterID> reg_slots;
@@ -50,7 +55,7 @@ namespace ucb
 
         for (auto& [reg, vreg]: bblock.parent()->frame())
         {
-            auto n = std::make_shared<DagNode>(0, InstrOpcode::OP_NONE, DagDefKind::DDK_MEM, vreg.ty(), "");
+            auto n = dag.make_node(0, InstrOpcode::OP_NONE, DagDefKind::DDK_MEM, vreg.ty());
             n->reg() = reg;
             n->mem_id() = mem_id++;
             reg_slots.push_back(reg);
@@ -61,7 +66,7 @@ namespace ucb
         {
             if (std::find(reg_slots.begin(), reg_slots.end(), id) == reg_slots.end())
             {
-                auto n = std::make_shared<DagNode>(0, InstrOpcode::OP_NONE, DagDefKind::DDK_REG, ty, "");
+                auto n = dag.make_node(0, InstrOpcode::OP_NONE, DagDefKind::DDK_REG, ty);
                 n->reg() = id;
                 dag.add_def(n);
             }
@@ -82,7 +87,7 @@ namespace ucb
             }
 
             //std::cout << "n ty " << inst.ty().val << std::endl;
-            auto n = std::make_shared<DagNode>(order++, inst.op(), dk, inst.ty(), inst.id());
+            auto n = dag.make_node(order++, inst.op(), dk, inst.ty(), inst.id());
 
             for (auto& op: inst.opnds())
             {
@@ -93,7 +98,7 @@ namespace ucb
                     continue;
                 }
 
-                std::shared_ptr<DagNode> arg;
+                DagNode *arg;
 
                 switch (op.kind())
                 {
@@ -145,12 +150,12 @@ namespace ucb
         }
 
         // match
-        _pats = _target->load_pats();
+        std::vector<std::uint32_t> candidates;
 
         for (auto n: dag.root_nodes())
         {
             //std::cout << "ROOT NODE" << std::endl;
-            recursive_match(n, *bblock.context());
+            recursive_match(n, candidates, dag, bblock);
         }
 
         // select
@@ -159,6 +164,8 @@ namespace ucb
             recursive_fill(n, bblock);
         }
 
+        scratch.reset();
+
         if (debug)
         {
             std::cout << "basic block after instruction selection:" << std::endl;
@@ -167,28 +174,54 @@ namespace ucb
         }
     }
 
-    void DynamicISel::recursive_match(std::shared_ptr<DagNode> n, CompileUnit& context)
+    void DynamicISel::recursive_match(DagNode *n, std::vector<std::uint32_t>& candidates, Dag& dag, BasicBlock& bblock)
     {
         //std::cout << "recursive match" << std::endl;
 
-        if (n->is_leaf())
+        // nodes with several uses are reached once per use
+        if (n->is_leaf() || !n->selected_insts().empty())
         {
             return;
         }
 
         for (auto arg: n->args())
         {
-            recursive_match(arg, context);
+            recursive_match(arg, candidates, dag, bblock);
         }
 
-        Pat *selected = nullptr;
-        std::vector<std::shared_ptr<DagNode>> selected_opnds;
+        std::vector<DagNode*> selected_opnds;
         float cost = 9000;
+        auto selected = select_pat(n, candidates, selected_opnds, cost);
 
-        auto count = 0;
+        // patterns only take immediates in a few places, anywhere else they
+        // are copied to a register first and the node is matched again
+        if (selected == nullptr && legalize_imms(n, candidates, dag, bblock))
+        {
+            selected = select_pat(n, candidates, selected_opnds, cost);
+        }
 
-        for (auto& pat: _pats)
+        if (selected == nullptr)
         {
+            std::cerr << "failed to match node" << std::endl;
+            n->dump(std::cerr, *bblock.context());
+            abort();
+        }
+
+        n->cost() = cost;
+        n->add_selected_insts(selected->replace(n));
+        n->add_selected_args(selected_opnds);
+    }
+
+    const Pat* DynamicISel::select_pat(DagNode *n, std::vector<std::uint32_t>& candidates, std::vector<DagNode*>& selected_opnds, float& cost)
+    {
+        const Pat *selected = nullptr;
+
+        // only the patterns the automaton lets through get a full match
+        _automaton.candidates(n, candidates);
+
+        for (auto i: candidates)
+        {
+            auto& pat = _automaton.pats()[i];
             auto res = pat.match(n);
 
             if (res.is_match)
@@ -209,19 +242,32 @@ namespace ucb
             }
         }
 
-        if (selected == nullptr)
+        return selected;
+    }
+
+    bool DynamicISel::legalize_imms(DagNode *n, std::vector<std::uint32_t>& candidates, Dag& dag, BasicBlock& bblock)
+    {
+        auto proc = bblock.parent();
+        auto changed = false;
+
+        for (auto& arg: n->args())
         {
-            std::cerr << "failed to match node" << std::endl;
-            n->dump(std::cerr, context);
-            abort();
+            if (arg->kind() != DagDefKind::DDK_IMM) { continue; }
+
+            auto cp = dag.make_node(n->order(), InstrOpcode::OP_CP, DagDefKind::DDK_REG, arg->ty());
+            auto id = proc->context()->symbols().intern("$imm." + std::to_string(proc->regs().size()));
+            cp->reg() = proc->add_vreg(id, arg->ty());
+            cp->add_arg(arg);
+            recursive_match(cp, candidates, dag, bblock);
+
+            arg = cp;
+            changed = true;
         }
 
-        n->cost() = cost;
-        n->add_selected_insts(selected->replace(n));
-        n->add_selected_args(std::move(selected_opnds));
+        return changed;
     }
 
-    void DynamicISel::recursive_fill(std::shared_ptr<DagNode> n, BasicBlock& bblock)
+    void DynamicISel::recursive_fill(DagNode *n, BasicBlock& bblock)
     {
         if (n->is_leaf())
         {
@@ -233,6 +279,8 @@ namespace ucb
             recursive_fill(arg, bblock);
         }
 
-        bblock.append_machine_insts(n->selected_insts());
+        // later uses of a shared node read the register it already wrote
+        bblock.append_machine_insts(std::move(n->selected_insts()));
+        n->selected_insts().clear();
     }
 }
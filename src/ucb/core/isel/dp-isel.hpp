@@ -2,6 +2,7 @@
 
 #include <ucb/core/target.hpp>
 #include <ucb/core/isel/isel.hpp>
+#include <ucb/core/isel/pat-automaton.hpp>
 // #include <ucb/core/isel/dag.hpp>
 // #include <ucb/core/isel/pat.hpp>
 #include <ucb/core/ir/basic-block.hpp>
@@ -12,18 +13,22 @@ namespace ucb
     {
     public:
         DynamicISel(std::shared_ptr<Target> target):
-            _target(std::move(target))
+            _target(std::move(target)),
+            _automaton(_target->load_pats())
         {
         }
 
         void run_on_procedure(std::shared_ptr<Procedure> proc, bool debug) override;
-        void run_on_bblock(BasicBlock& bblock, bool debug);
+        void run_on_bblock(BasicBlock& bblock, Arena& scratch, bool debug);
 
     private:
         std::shared_ptr<Target> _target;
-        std::vector<Pat> _pats;
+        // built once per target, read only afterwards
+        PatAutomaton _automaton;
 
-        void recursive_match(std::shared_ptr<DagNode> n, CompileUnit& context);
-        void recursive_fill(std::shared_ptr<DagNode> n, BasicBlock& bblock);
+        void recursive_match(DagNode *n, std::vector<std::uint32_t>& candidates, Dag& dag, BasicBlock& bblock);
+        const Pat* select_pat(DagNode *n, std::vector<std::uint32_t>& candidates, std::vector<DagNode*>& selected_opnds, float& cost);
+        bool legalize_imms(DagNode *n, std::vector<std::uint32_t>& candidates, Dag& dag, BasicBlock& bblock);
+        void recursive_fill(DagNode *n, BasicBlock& bblock);
     };
 }
@@ -0,0 +1,191 @@
+#include <ucb/core/isel/pat-automaton.hpp>
+
+#include <algorithm>
+
+namespace ucb
+{
+    // leaf operands are labelled by their def kind, nested instructions by
+    // opcode and id with this bit set
+    constexpr std::uint64_t INST_LABEL = std::uint64_t{1} << 63;
+
+    static std::uint64_t def_kind_of(OperandKind kind)
+    {
+        switch (kind)
+        {
+            case OperandKind::OK_VIRTUAL_REG:
+                return DagDefKind::DDK_REG;
+
+            case OperandKind::OK_INTEGER_CONST:
+            case OperandKind::OK_UNSIGNED_CONST:
+            case OperandKind::OK_FLOAT_CONST:
+                return DagDefKind::DDK_IMM;
+
+            case OperandKind::OK_BASIC_BLOCK:
+                return DagDefKind::DDK_ADDR;
+
+            case OperandKind::OK_FRAME_SLOT:
+                return DagDefKind::DDK_MEM;
+
+            default:
+                assert(false && "unreachable");
+                return DagDefKind::DDK_NONE;
+        }
+    }
+
+    PatAutomaton::PatAutomaton(std::span<const Pat> pats):
+        _pats{pats}
+    {
+        for (std::uint32_t i = 0; i < pats.size(); ++i)
+        {
+            auto& root = pats[i].pat;
+
+            if (root.kind != PatNode::Inst)
+            {
+                _unkeyed.push_back(i);
+                continue;
+            }
+
+            // T_SAME at the root resolves against T_NONE in Pat::match
+            auto ty = root.ty == T_SAME ? T_NONE : root.ty;
+            auto state = root_state(root_key(root.opc, intern_id(root.id), ty));
+
+            if (root.is_va_pat)
+            {
+                _states[state].accept_any.push_back(i);
+                continue;
+            }
+
+            for (auto& opnd: root.opnds)
+            {
+                state = next_state(state, opnd_label(opnd));
+            }
+
+            _states[state].accept.push_back(i);
+        }
+    }
+
+    void PatAutomaton::candidates(DagNode *n, std::vector<std::uint32_t>& res) const
+    {
+        res = _unkeyed;
+
+        // patterns without an id match any node id
+        auto it = _roots.find(root_key(n->opc(), 0, n->ty()));
+
+        if (it != _roots.end())
+        {
+            walk(it->second, n->args(), 0, res);
+        }
+
+        if (auto id = find_id(n->name()); id != 0)
+        {
+            it = _roots.find(root_key(n->opc(), id, n->ty()));
+
+            if (it != _roots.end())
+            {
+                walk(it->second, n->args(), 0, res);
+            }
+        }
+
+        // an argument can reach the same pattern through several labels
+        std::sort(res.begin(), res.end());
+        res.erase(std::unique(res.begin(), res.end()), res.end());
+    }
+
+    std::uint64_t PatAutomaton::root_key(InstrOpcode opc, std::uint32_t id, TypeID ty)
+    {
+        // Pat::match compares type values exactly, sizes are checked later
+        return (static_cast<std::uint64_t>(opc) << 56)
+            | (static_cast<std::uint64_t>(id) << 32)
+            | static_cast<std::uint32_t>(ty.val);
+    }
+
+    std::uint64_t PatAutomaton::inst_label(InstrOpcode opc, std::uint32_t id)
+    {
+        return INST_LABEL | (static_cast<std::uint64_t>(id) << 32) | opc;
+    }
+
+    std::uint32_t PatAutomaton::intern_id(std::string_view id)
+    {
+        if (id.empty())
+        {
+            return 0;
+        }
+
+        return _ids.try_emplace(id, _ids.size() + 1).first->second;
+    }
+
+    std::uint32_t PatAutomaton::find_id(std::string_view id) const
+    {
+        auto it = _ids.find(id);
+        return it == _ids.end() ? 0 : it->second;
+    }
+
+    std::uint64_t PatAutomaton::opnd_label(const PatNode& pat)
+    {
+        if (pat.kind == PatNode::Inst)
+        {
+            return inst_label(pat.opc, intern_id(pat.id));
+        }
+
+        return def_kind_of(pat.opnd);
+    }
+
+    std::uint32_t PatAutomaton::root_state(std::uint64_t key)
+    {
+        auto [it, inserted] = _roots.try_emplace(key, _states.size());
+
+        if (inserted)
+        {
+            _states.emplace_back();
+        }
+
+        return it->second;
+    }
+
+    std::uint32_t PatAutomaton::next_state(std::uint32_t state, std::uint64_t label)
+    {
+        for (auto [l, next]: _states[state].edges)
+        {
+            if (l == label)
+            {
+                return next;
+            }
+        }
+
+        std::uint32_t next = _states.size();
+        _states.emplace_back();
+        _states[state].edges.emplace_back(label, next);
+        return next;
+    }
+
+    void PatAutomaton::walk(std::uint32_t state, DagNodeList& args, std::size_t i, std::vector<std::uint32_t>& res) const
+    {
+        auto& s = _states[state];
+        res.insert(res.end(), s.accept_any.begin(), s.accept_any.end());
+
+        if (i == args.size())
+        {
+            res.insert(res.end(), s.accept.begin(), s.accept.end());
+            return;
+        }
+
+        auto arg = args[i];
+        auto kind_label = static_cast<std::uint64_t>(arg->kind());
+        auto any_label = inst_label(arg->opc(), 0);
+        auto id_label = any_label;
+
+        if (auto id = find_id(arg->name()); id != 0)
+        {
+            id_label = inst_label(arg->opc(), id);
+        }
+
+        for (auto [label, next]: s.edges)
+        {
+            if (label == kind_label
+                || (arg->opc() != InstrOpcode::OP_NONE && (label == any_label || label == id_label)))
+            {
+                walk(next, args, i + 1, res);
+            }
+        }
+    }
+}
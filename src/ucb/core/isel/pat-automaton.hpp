@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ucb/core/isel/dag.hpp>
+#include <ucb/core/isel/pat.hpp>
+
+namespace ucb
+{
+    // decision tree built once over a target's patterns. the root is picked
+    // by the node's opcode, type and id (cmp predicates are ids), then every
+    // argument of the node walks one level down the tree, either through the
+    // edge for its def kind or through the edge for its own opcode when the
+    // pattern nests an instruction there. the states reached once the args
+    // run out hold the only patterns worth running the full Pat::match on
+    class PatAutomaton
+    {
+    public:
+        explicit PatAutomaton(std::span<const Pat> pats);
+
+        std::span<const Pat> pats() const { return _pats; }
+
+        // indices into pats() of the patterns that may match n, in the
+        // order they were declared
+        void candidates(DagNode *n, std::vector<std::uint32_t>& res) const;
+
+    private:
+        struct State
+        {
+            std::vector<std::pair<std::uint64_t, std::uint32_t>> edges;
+            // patterns whose operand list ends here
+            std::vector<std::uint32_t> accept;
+            // variadic patterns, they take any argument list
+            std::vector<std::uint32_t> accept_any;
+        };
+
+        std::span<const Pat> _pats;
+        std::vector<State> _states;
+        std::unordered_map<std::uint64_t, std::uint32_t> _roots;
+        // ids used by the patterns, 0 stands for a pattern without an id.
+        // the views point into the target's pattern table
+        std::unordered_map<std::string_view, std::uint32_t> _ids;
+        // patterns that do not start with an instruction, always tried
+        std::vector<std::uint32_t> _unkeyed;
+
+        static std::uint64_t root_key(InstrOpcode opc, std::uint32_t id, TypeID ty);
+        static std::uint64_t inst_label(InstrOpcode opc, std::uint32_t id);
+
+        std::uint32_t intern_id(std::string_view id);
+        std::uint32_t find_id(std::string_view id) const;
+        std::uint64_t opnd_label(const PatNode& pat);
+        std::uint32_t root_state(std::uint64_t key);
+        std::uint32_t next_state(std::uint32_t state, std::uint64_t label);
+        void walk(std::uint32_t state, DagNodeList& args, std::size_t i, std::vector<std::uint32_t>& res) const;
+    };
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <ucb/core/isel/pat.hpp>
+
+namespace ucb
+{
+    // targets write their patterns with these, nested and owning. they only
+    // exist while a PatTable is evaluated at compile time
+    struct PatNodeSpec
+    {
+        PatNode::Kind kind;
+        TypeID ty;
+        InstrOpcode opc;
+        OperandKind opnd;
+        std::string id;
+        bool is_va_pat{false};
+
+        std::vector<PatNodeSpec> opnds;
+    };
+
+    struct RepNodeSpec
+    {
+        TypeID ty;
+        MachineOpc opc;
+        std::vector<std::int8_t> opnds;
+
+        bool def_is_also_use{false};
+        bool is_va_rep{false};
+    };
+
+    struct PatSpec
+    {
+        std::uint8_t cost;
+
+        PatNodeSpec pat;
+        std::vector<RepNodeSpec> reps;
+    };
+
+    using PatBuilder = std::vector<PatSpec> (*)();
+
+    // flattens the patterns returned by BUILD into static read only arrays
+    // at compile time, every Pat, PatNode and RepNode handed out is a view
+    // into them so nothing is built or allocated at runtime
+    template<PatBuilder BUILD>
+    class PatTable
+    {
+    public:
+        static constexpr std::span<const Pat> pats()
+        {
+            return { DATA.pats, SIZES.pats };
+        }
+
+        // index of a pattern that can never be selected because another one
+        // matches everything it does at a lower cost, or at the same cost
+        // and declared earlier. -1 when there is none
+        static constexpr int first_unreachable()
+        {
+            auto specs = BUILD();
+
+            for (std::size_t i = 0; i < specs.size(); ++i)
+            {
+                for (std::size_t j = 0; j < specs.size(); ++j)
+                {
+                    if (i == j || !subsumes(specs[j].pat, specs[i].pat))
+                    {
+                        continue;
+                    }
+
+                    if (specs[j].cost < specs[i].cost || (specs[j].cost == specs[i].cost && j < i))
+                    {
+                        return i;
+                    }
+                }
+            }
+
+            return -1;
+        }
+
+    private:
+        struct Sizes
+        {
+            std::size_t pats{0};
+            std::size_t nodes{0};
+            std::size_t reps{0};
+            std::size_t rep_opnds{0};
+            std::size_t chars{0};
+        };
+
+        static constexpr void count(const PatNodeSpec& node, Sizes& sizes)
+        {
+            sizes.chars += node.id.size();
+            sizes.nodes += node.opnds.size();
+
+            for (auto& opnd: node.opnds)
+            {
+                count(opnd, sizes);
+            }
+        }
+
+        static constexpr Sizes SIZES = []
+        {
+            Sizes sizes;
+
+            for (auto& spec: BUILD())
+            {
+                ++sizes.pats;
+                count(spec.pat, sizes);
+                sizes.reps += spec.reps.size();
+
+                for (auto& rep: spec.reps)
+                {
+                    sizes.rep_opnds += rep.opnds.size();
+                }
+            }
+
+            return sizes;
+        }();
+
+        // arrays are one longer than needed so none of them is empty
+        struct Storage
+        {
+            Pat pats[SIZES.pats + 1];
+            PatNode nodes[SIZES.nodes + 1];
+            RepNode reps[SIZES.reps + 1];
+            std::int8_t rep_opnds[SIZES.rep_opnds + 1];
+            char chars[SIZES.chars + 1];
+        };
+
+        struct Cursor
+        {
+            std::size_t nodes{0};
+            std::size_t reps{0};
+            std::size_t rep_opnds{0};
+            std::size_t chars{0};
+        };
+
+        // self is the static DATA being initialized, the views point into it
+        static constexpr PatNode flatten(const PatNodeSpec& spec, Storage& res, const Storage *self, Cursor& cur)
+        {
+            PatNode node{
+                .kind = spec.kind,
+                .ty = spec.ty,
+                .opc = spec.opc,
+                .opnd = spec.opnd,
+                .id = {},
+                .is_va_pat = spec.is_va_pat,
+                .opnds = {}
+            };
+
+            if (!spec.id.empty())
+            {
+                for (std::size_t i = 0; i < spec.id.size(); ++i)
+                {
+                    res.chars[cur.chars + i] = spec.id[i];
+                }
+
+                node.id = { self->chars + cur.chars, spec.id.size() };
+                cur.chars += spec.id.size();
+            }
+
+            // children are laid out next to each other so they form a span
+            auto first = cur.nodes;
+            cur.nodes += spec.opnds.size();
+
+            for (std::size_t i = 0; i < spec.opnds.size(); ++i)
+            {
+                res.nodes[first + i] = flatten(spec.opnds[i], res, self, cur);
+            }
+
+            node.opnds = { self->nodes + first, spec.opnds.size() };
+            return node;
+        }
+
+        static constexpr Storage build(const Storage *self)
+        {
+            Storage res{};
+            Cursor cur;
+            std::size_t i = 0;
+
+            for (auto& spec: BUILD())
+            {
+                auto first_rep = cur.reps;
+
+                for (auto& rep_spec: spec.reps)
+                {
+                    auto first_opnd = cur.rep_opnds;
+
+                    for (auto op: rep_spec.opnds)
+                    {
+                        res.rep_opnds[cur.rep_opnds++] = op;
+                    }
+
+                    res.reps[cur.reps++] = RepNode{
+                        .ty = rep_spec.ty,
+                        .opc = rep_spec.opc,
+                        .opnds = { self->rep_opnds + first_opnd, rep_spec.opnds.size() },
+                        .def_is_also_use = rep_spec.def_is_also_use,
+                        .is_va_rep = rep_spec.is_va_rep
+                    };
+                }
+
+                res.pats[i++] = Pat{
+                    .cost = spec.cost,
+                    .pat = flatten(spec.pat, res, self, cur),
+                    .reps = { self->reps + first_rep, spec.reps.size() }
+                };
+            }
+
+            return res;
+        }
+
+        static constexpr Storage DATA = build(&PatTable::DATA);
+
+        static constexpr bool subsumes_ty(TypeID a, TypeID b)
+        {
+            return a == b || (a.size == 0 && a.val == b.val && b != T_SAME);
+        }
+
+        // a matches every dag node b matches
+        static constexpr bool subsumes(const PatNodeSpec& a, const PatNodeSpec& b)
+        {
+            if (a.kind != b.kind
+                || a.opc != b.opc
+                || a.is_va_pat != b.is_va_pat
+                || !subsumes_ty(a.ty, b.ty)
+                || (!a.id.empty() && a.id != b.id)
+                || a.opnds.size() != b.opnds.size())
+            {
+                return false;
+            }
+
+            if (a.kind == PatNode::Opnd && a.opnd != b.opnd)
+            {
+                return false;
+            }
+
+            for (std::size_t i = 0; i < a.opnds.size(); ++i)
+            {
+                if (!subsumes(a.opnds[i], b.opnds[i]))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    };
+}
@@ -26,14 +26,14 @@ namespace ucb
         }
     }
 
-    MatchResult Pat::match(std::shared_ptr<DagNode> n)
+    MatchResult Pat::match(DagNode *n) const
     {
         assert(n);
         auto same_ty = T_NONE;
         return pat.match(n, same_ty);
     }
 
-    MatchResult PatNode::match(std::shared_ptr<DagNode> n, TypeID& same_ty)
+    MatchResult PatNode::match(DagNode *n, TypeID& same_ty) const
     {
         assert(n);
         MatchResult res;
@@ -57,7 +57,7 @@ namespace ucb
             same_ty = node_ty;
         }
 
-        if (id != "" && id != n->id())
+        if (!id.empty() && id != n->name())
         {
             return res;
         }
@@ -78,7 +78,7 @@ namespace ucb
                     if (arg->kind() == DagDefKind::DDK_IMM
                         || arg->kind() == DagDefKind::DDK_REG)
                     {
-                        res.selected_opnds.push_back(std::move(arg));
+                        res.selected_opnds.push_back(arg);
                     }
                     else
                     {
@@ -144,7 +144,7 @@ namespace ucb
                 break;
             }
 
-            res.selected_opnds.push_back(std::move(n));
+            res.selected_opnds.push_back(n);
         }
 
         res.is_match = true;
@@ -152,7 +152,7 @@ namespace ucb
         return res;
     }
 
-    void PatNode::get_args(std::shared_ptr<DagNode> n, std::vector<std::shared_ptr<DagNode>>& args)
+    void PatNode::get_args(DagNode *n, std::vector<DagNode*>& args) const
     {
         assert(n);
 
@@ -164,7 +164,7 @@ namespace ucb
                 for (auto arg: n->args())
                 {
                     assert(arg != nullptr);
-                    args.push_back(std::move(arg));
+                    args.push_back(arg);
                 }
             }
             else
@@ -188,16 +188,16 @@ namespace ucb
 
         if (kind == PatNode::Opnd)
         {
-            args.push_back(std::move(n));
+            args.push_back(n);
         }
     }
 
-    std::list<MachineInstruction> Pat::replace(std::shared_ptr<DagNode> n)
+    std::list<MachineInstruction> Pat::replace(DagNode *n) const
     {
         assert(n);
         std::list<MachineInstruction> res;
 
-        std::vector<std::shared_ptr<DagNode>> args;
+        std::vector<DagNode*> args;
         pat.get_args(n, args);
 
         for (auto& r: reps)
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <span>
+#include <string_view>
 #include <vector>
 
 #include <ucb/core/ir/instruction.hpp>
@@ -11,7 +13,7 @@ namespace ucb
     struct MatchResult
     {
         bool is_match;
-        std::vector<std::shared_ptr<DagNode>> selected_opnds;
+        std::vector<DagNode*> selected_opnds;
     };
 
     struct PatNode
@@ -25,33 +27,34 @@ namespace ucb
         TypeID ty;
         InstrOpcode opc;
         OperandKind opnd;
-        std::string id;
+        std::string_view id;
         bool is_va_pat{false};
 
-        std::vector<PatNode> opnds;
+        std::span<const PatNode> opnds;
 
-        MatchResult match(std::shared_ptr<DagNode> n, TypeID& same_ty);
-        void get_args(std::shared_ptr<DagNode> n, std::vector<std::shared_ptr<DagNode>>& args);
+        MatchResult match(DagNode *n, TypeID& same_ty) const;
+        void get_args(DagNode *n, std::vector<DagNode*>& args) const;
     };
 
     struct RepNode
     {
         TypeID ty;
         MachineOpc opc;
-        std::vector<std::int8_t> opnds;
+        std::span<const std::int8_t> opnds;
 
         bool def_is_also_use{false};
         bool is_va_rep{false};
     };
 
+    // patterns are read only views into a PatTable, see pat-table.hpp
     struct Pat
     {
         std::uint8_t cost;
 
         PatNode pat;
-        std::vector<RepNode> reps;
+        std::span<const RepNode> reps;
 
-        MatchResult match(std::shared_ptr<DagNode> n);
-        std::list<MachineInstruction> replace(std::shared_ptr<DagNode> n);
+        MatchResult match(DagNode *n) const;
+        std::list<MachineInstruction> replace(DagNode *n) const;
     };
 }
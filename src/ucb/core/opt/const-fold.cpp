@@ -0,0 +1,236 @@
+#include <ucb/core/opt/const-fold.hpp>
+
+#include <cstdint>
+#include <optional>
+
+#include <ucb/core/opt/rewrite.hpp>
+
+namespace ucb
+{
+    static bool is_const(const Operand& opnd)
+    {
+        return opnd.kind() == OperandKind::OK_INTEGER_CONST
+            || opnd.kind() == OperandKind::OK_UNSIGNED_CONST;
+    }
+
+    // values are computed on 64 bits and cut back to the type's size
+    static std::optional<Operand> make_const(std::uint64_t val, TypeID ty)
+    {
+        auto bits = ty.size;
+
+        if (bits == 0 || bits > 64)
+        {
+            return std::nullopt;
+        }
+
+        auto shift = 64 - bits;
+
+        if (ty_is_signed_int(ty))
+        {
+            auto res = static_cast<std::int64_t>(val << shift) >> shift;
+            return Operand(static_cast<long int>(res), ty);
+        }
+
+        if (ty_is_unsigned_int(ty))
+        {
+            return Operand(static_cast<unsigned long>((val << shift) >> shift), ty);
+        }
+
+        return std::nullopt;
+    }
+
+    static std::optional<Operand> fold(Instruction& inst)
+    {
+        auto& opnds = inst.opnds();
+        auto ty = inst.ty();
+
+        if (opnds.size() < 2 || !opnds[0].is_def())
+        {
+            return std::nullopt;
+        }
+
+        for (std::size_t i = 1; i < opnds.size(); ++i)
+        {
+            if (!is_const(opnds[i]) || opnds[i].ty() != ty)
+            {
+                return std::nullopt;
+            }
+        }
+
+        auto is_signed = ty_is_signed_int(ty);
+        std::uint64_t a = opnds[1].get_unsigned_val();
+
+        if (inst.op() == InstrOpcode::OP_NOT && opnds.size() == 2)
+        {
+            return make_const(~a, opnds[0].ty());
+        }
+
+        if (opnds.size() != 3)
+        {
+            return std::nullopt;
+        }
+
+        std::uint64_t b = opnds[2].get_unsigned_val();
+        auto sa = static_cast<std::int64_t>(a);
+        auto sb = static_cast<std::int64_t>(b);
+        std::uint64_t res;
+
+        switch (inst.op())
+        {
+        case InstrOpcode::OP_ADD: res = a + b; break;
+        case InstrOpcode::OP_SUB: res = a - b; break;
+        case InstrOpcode::OP_MUL: res = a * b; break;
+        case InstrOpcode::OP_AND: res = a & b; break;
+        case InstrOpcode::OP_OR: res = a | b; break;
+        case InstrOpcode::OP_XOR: res = a ^ b; break;
+
+        case InstrOpcode::OP_DIV:
+        case InstrOpcode::OP_REM:
+            // left to trap at run time
+            if (b == 0 || (is_signed && sb == -1 && sa == INT64_MIN))
+            {
+                return std::nullopt;
+            }
+
+            if (inst.op() == InstrOpcode::OP_DIV)
+            {
+                res = is_signed ? static_cast<std::uint64_t>(sa / sb) : a / b;
+            }
+            else
+            {
+                res = is_signed ? static_cast<std::uint64_t>(sa % sb) : a % b;
+            }
+
+            break;
+
+        case InstrOpcode::OP_SHL:
+        case InstrOpcode::OP_SHR:
+            if (b >= ty.size)
+            {
+                return std::nullopt;
+            }
+
+            if (inst.op() == InstrOpcode::OP_SHL)
+            {
+                res = a << b;
+            }
+            else
+            {
+                res = is_signed ? static_cast<std::uint64_t>(sa >> b) : a >> b;
+            }
+
+            break;
+
+        default:
+            return std::nullopt;
+        }
+
+        return make_const(res, opnds[0].ty());
+    }
+
+    // the outcome of a cmp on two constants
+    static std::optional<bool> fold_cmp(Instruction& cmp)
+    {
+        auto& opnds = cmp.opnds();
+
+        if (!is_const(opnds[1]) || !is_const(opnds[2]) || opnds[1].ty() != opnds[2].ty())
+        {
+            return std::nullopt;
+        }
+
+        auto mode = cmp.parent()->context()->symbols().name(cmp.id());
+
+        auto compare = [&](auto a, auto b) -> std::optional<bool>
+        {
+            if (mode == "eq") { return a == b; }
+            if (mode == "ne") { return a != b; }
+            if (mode == "lt") { return a < b; }
+            if (mode == "le") { return a <= b; }
+            if (mode == "gt") { return a > b; }
+            if (mode == "ge") { return a >= b; }
+            return std::nullopt;
+        };
+
+        if (opnds[1].kind() == OperandKind::OK_INTEGER_CONST)
+        {
+            return compare(opnds[1].get_integer_val(), opnds[2].get_integer_val());
+        }
+
+        return compare(opnds[1].get_unsigned_val(), opnds[2].get_unsigned_val());
+    }
+
+    void ConstantFolding::apply(std::shared_ptr<Procedure> proc)
+    {
+        proc->compute_predecessors();
+
+        // the register's only def, when it copies a constant
+        auto const_of = [&](RegisterID reg) -> const Operand*
+        {
+            if (!is_single_def(*proc, reg) || proc->is_param(reg))
+            {
+                return nullptr;
+            }
+
+            auto def = proc->get_register(reg)->defs()[0];
+            auto& opnds = def->opnds();
+
+            if (def->op() != InstrOpcode::OP_CP || !is_const(opnds[1]))
+            {
+                return nullptr;
+            }
+
+            return &opnds[1];
+        };
+
+        // defs come before their uses in reverse post order, so constants
+        // carry through chains of instructions in one sweep
+        for (auto bblock: proc->reverse_post_order())
+        {
+            auto& insts = bblock->insts();
+            auto it = insts.begin();
+
+            while (it != insts.end())
+            {
+                auto& inst = *it;
+                ++it;
+
+                auto& opnds = inst.opnds();
+
+                for (std::size_t i = 0; i < opnds.size(); ++i)
+                {
+                    if (opnds[i].is_def()) { continue; }
+
+                    auto val = const_of(opnds[i].get_virtual_reg());
+
+                    if (val != nullptr && val->ty() == opnds[i].ty())
+                    {
+                        inst.set_operand(i, *val);
+                    }
+                }
+
+                if (inst.op() == InstrOpcode::OP_BRC)
+                {
+                    auto cnd = opnds[0].get_virtual_reg();
+
+                    if (!is_single_def(*proc, cnd) || proc->is_param(cnd)) { continue; }
+
+                    auto cmp = proc->get_register(cnd)->defs()[0];
+
+                    if (cmp->op() != InstrOpcode::OP_CMP) { continue; }
+
+                    auto taken = fold_cmp(*cmp);
+
+                    if (!taken) { continue; }
+
+                    auto& br = bblock->insert_instr(insts.iterator_to(&inst), InstrOpcode::OP_BR, T_STATIC_ADDRESS);
+                    br.add_operand(opnds[*taken ? 1 : 2]);
+                    inst.erase_from_parent();
+                }
+                else if (auto res = fold(inst))
+                {
+                    replace_def(*proc, inst, *res);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <ucb/core/pass-manager.hpp>
+
+namespace ucb
+{
+    // integer constant folding. single def registers copied from a constant
+    // are read as that constant, instructions whose operands all end up
+    // constant become copies of their result and a brc on a comparison of
+    // constants becomes a br to the target it always takes
+    class ConstantFolding : public Pass
+    {
+    public:
+        void apply(std::shared_ptr<Procedure> proc) override;
+    };
+}
@@ -0,0 +1,110 @@
+#include <ucb/core/opt/dce.hpp>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace ucb
+{
+    void DeadCodeElimination::apply(std::shared_ptr<Procedure> proc)
+    {
+        std::unordered_set<std::uint64_t> dead_slots;
+
+        for (auto& [reg, vreg]: proc->frame())
+        {
+            auto is_dead = std::all_of(vreg.uses().begin(), vreg.uses().end(), [&](auto inst)
+            {
+                auto& opnds = inst->opnds();
+
+                return inst->op() == InstrOpcode::OP_STORE
+                    && opnds[1].get_virtual_reg() != reg;
+            });
+
+            if (is_dead)
+            {
+                dead_slots.insert(reg.val);
+            }
+        }
+
+        std::unordered_set<Instruction*> live;
+        std::unordered_set<std::uint64_t> needed;
+        std::vector<Instruction*> worklist;
+
+        auto mark = [&](Instruction *inst)
+        {
+            if (live.insert(inst).second)
+            {
+                worklist.push_back(inst);
+            }
+        };
+
+        for (auto& bblock: proc->bblocks())
+        {
+            for (auto& inst: bblock.insts())
+            {
+                auto is_dead_store = inst.is_store()
+                    && dead_slots.contains(inst.opnds()[0].get_virtual_reg().val);
+
+                if (inst.is_terminator()
+                    || inst.op() == InstrOpcode::OP_CALL
+                    || (inst.is_store() && !is_dead_store))
+                {
+                    mark(&inst);
+                }
+            }
+        }
+
+        while (!worklist.empty())
+        {
+            auto inst = worklist.back();
+            worklist.pop_back();
+
+            for (auto& opnd: inst->opnds())
+            {
+                auto reg = opnd.get_virtual_reg();
+
+                if (opnd.is_def() || reg == NO_REG || !needed.insert(reg.val).second)
+                {
+                    continue;
+                }
+
+                for (auto def: proc->get_register(reg)->defs())
+                {
+                    mark(def);
+                }
+            }
+        }
+
+        for (auto& bblock: proc->bblocks())
+        {
+            auto& insts = bblock.insts();
+            auto it = insts.begin();
+
+            while (it != insts.end())
+            {
+                auto& inst = *it;
+                ++it;
+
+                if (!live.contains(&inst))
+                {
+                    inst.erase_from_parent();
+                }
+            }
+        }
+
+        // slots left without loads or stores take no room in the frame
+        std::vector<RegisterID> unused_slots;
+
+        for (auto& [reg, vreg]: proc->frame())
+        {
+            if (vreg.uses().empty())
+            {
+                unused_slots.push_back(reg);
+            }
+        }
+
+        for (auto reg: unused_slots)
+        {
+            proc->remove_frame_slot(reg);
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <ucb/core/pass-manager.hpp>
+
+namespace ucb
+{
+    // removes instructions whose results are never needed. terminators,
+    // calls and stores are needed, except stores to frame slots that are
+    // never loaded from nor have their address taken. since the ir is not
+    // in ssa form a register is needed as a whole, every def of a register
+    // some needed instruction reads is kept
+    class DeadCodeElimination : public Pass
+    {
+    public:
+        void apply(std::shared_ptr<Procedure> proc) override;
+    };
+}
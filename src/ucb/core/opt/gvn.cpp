@@ -0,0 +1,296 @@
+#include <ucb/core/opt/gvn.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <ucb/core/opt/rewrite.hpp>
+
+namespace ucb
+{
+    using ExprKey = std::vector<std::uint64_t>;
+    // value known to be in a frame slot, by slot register
+    using MemState = std::unordered_map<std::uint64_t, Operand>;
+
+    static bool is_numbered(InstrOpcode op)
+    {
+        switch (op)
+        {
+        case InstrOpcode::OP_ADD:
+        case InstrOpcode::OP_SUB:
+        case InstrOpcode::OP_MUL:
+        case InstrOpcode::OP_DIV:
+        case InstrOpcode::OP_REM:
+        case InstrOpcode::OP_NOT:
+        case InstrOpcode::OP_AND:
+        case InstrOpcode::OP_OR:
+        case InstrOpcode::OP_XOR:
+        case InstrOpcode::OP_SHL:
+        case InstrOpcode::OP_SHR:
+        case InstrOpcode::OP_CAST:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    static bool is_commutative(InstrOpcode op)
+    {
+        return op == InstrOpcode::OP_ADD
+            || op == InstrOpcode::OP_MUL
+            || op == InstrOpcode::OP_AND
+            || op == InstrOpcode::OP_OR
+            || op == InstrOpcode::OP_XOR;
+    }
+
+    static ExprKey opnd_key(const Operand& opnd)
+    {
+        std::uint64_t val = 0;
+
+        switch (opnd.kind())
+        {
+        case OperandKind::OK_VIRTUAL_REG:
+            val = std::bit_cast<std::uint64_t>(opnd.get_virtual_reg());
+            break;
+
+        case OperandKind::OK_INTEGER_CONST:
+            val = std::bit_cast<std::uint64_t>(opnd.get_integer_val());
+            break;
+
+        case OperandKind::OK_UNSIGNED_CONST:
+            val = opnd.get_unsigned_val();
+            break;
+
+        case OperandKind::OK_FLOAT_CONST:
+            val = std::bit_cast<std::uint64_t>(opnd.get_float_val());
+            break;
+
+        default:
+            val = std::bit_cast<std::uint64_t>(static_cast<std::int64_t>(opnd.get_bblock_idx()));
+            break;
+        }
+
+        return {
+            static_cast<std::uint64_t>(opnd.kind()),
+            static_cast<std::uint64_t>(opnd.ty().val),
+            opnd.ty().size,
+            val
+        };
+    }
+
+    // a use reading the same value anywhere in the procedure
+    static bool is_stable(Procedure& proc, const Operand& opnd)
+    {
+        if (opnd.kind() == OperandKind::OK_VIRTUAL_REG)
+        {
+            return is_single_def(proc, opnd.get_virtual_reg());
+        }
+
+        return opnd.kind() != OperandKind::OK_BASIC_BLOCK;
+    }
+
+    void GlobalValueNumbering::apply(std::shared_ptr<Procedure> proc)
+    {
+        proc->compute_predecessors();
+
+        auto& bblocks = proc->bblocks();
+
+        // slots whose address is read by anything but their own loads and
+        // stores, calls and stores through pointers may write them
+        std::unordered_set<std::uint64_t> escaped;
+
+        for (auto& [reg, vreg]: proc->frame())
+        {
+            for (auto inst: vreg.uses())
+            {
+                auto& opnds = inst->opnds();
+
+                auto is_access =
+                    (inst->op() == InstrOpcode::OP_LOAD && opnds[1].get_virtual_reg() == reg)
+                    || (inst->op() == InstrOpcode::OP_STORE && opnds[1].get_virtual_reg() != reg);
+
+                if (!is_access)
+                {
+                    escaped.insert(reg.val);
+                }
+            }
+        }
+
+        auto kill_escaped = [&](MemState& mem)
+        {
+            for (auto reg: escaped)
+            {
+                mem.erase(reg);
+            }
+        };
+
+        // expressions available in the current block, keys are pushed on
+        // scope as they are added and popped when their block is left
+        std::map<ExprKey, Operand> exprs;
+        std::vector<ExprKey> scope;
+        std::vector<MemState> mem_outs(bblocks.size());
+
+        struct Visit
+        {
+            BasicBlock *bblock;
+            std::size_t scope_size;
+            bool is_exit;
+        };
+
+        std::vector<Visit> stack;
+        stack.push_back({ &bblocks[0], 0, false });
+
+        while (!stack.empty())
+        {
+            auto visit = stack.back();
+            stack.pop_back();
+
+            if (visit.is_exit)
+            {
+                while (scope.size() > visit.scope_size)
+                {
+                    exprs.erase(scope.back());
+                    scope.pop_back();
+                }
+
+                continue;
+            }
+
+            auto bblock = visit.bblock;
+            stack.push_back({ bblock, scope.size(), true });
+
+            // the only predecessor is also the idom, so it is already done
+            MemState mem;
+            auto preds = bblock->predecessors();
+
+            if (preds.size() == 1 && preds[0] == bblock->idom())
+            {
+                mem = mem_outs[preds[0]->idx()];
+            }
+
+            auto& insts = bblock->insts();
+            auto it = insts.begin();
+
+            while (it != insts.end())
+            {
+                // the instruction may be replaced
+                auto& inst = *it;
+                ++it;
+
+                auto& opnds = inst.opnds();
+                auto def = def_of(inst);
+
+                switch (inst.op())
+                {
+                case InstrOpcode::OP_LOAD:
+                {
+                    auto slot = opnds[1].get_virtual_reg();
+
+                    if (!proc->is_frame_slot(slot)) { break; }
+
+                    auto known = mem.find(slot.val);
+
+                    if (known != mem.end() && known->second.ty() == opnds[0].ty())
+                    {
+                        replace_def(*proc, inst, known->second);
+                    }
+                    else if (is_single_def(*proc, def))
+                    {
+                        mem[slot.val] = as_use(opnds[0]);
+                    }
+
+                    break;
+                }
+
+                case InstrOpcode::OP_STORE:
+                {
+                    auto ref = opnds[0].get_virtual_reg();
+
+                    if (!proc->is_frame_slot(ref))
+                    {
+                        kill_escaped(mem);
+                    }
+                    else if (is_stable(*proc, opnds[1]))
+                    {
+                        mem[ref.val] = as_use(opnds[1]);
+                    }
+                    else
+                    {
+                        mem.erase(ref.val);
+                    }
+
+                    break;
+                }
+
+                case InstrOpcode::OP_CALL:
+                    kill_escaped(mem);
+                    break;
+
+                case InstrOpcode::OP_CP:
+                    if (is_single_def(*proc, def) && is_stable(*proc, opnds[1])
+                        && opnds[1].ty() == opnds[0].ty())
+                    {
+                        replace_def(*proc, inst, opnds[1]);
+                    }
+
+                    break;
+
+                default:
+                {
+                    if (!is_numbered(inst.op()) || !is_single_def(*proc, def)) { break; }
+
+                    ExprKey key = {
+                        static_cast<std::uint64_t>(inst.op()),
+                        static_cast<std::uint64_t>(inst.ty().val),
+                        inst.ty().size,
+                        static_cast<std::uint64_t>(opnds[0].ty().val),
+                        opnds[0].ty().size
+                    };
+
+                    std::vector<ExprKey> args;
+                    auto is_available = true;
+
+                    for (std::size_t i = 1; i < opnds.size(); ++i)
+                    {
+                        is_available = is_available && is_stable(*proc, opnds[i]);
+                        args.push_back(opnd_key(opnds[i]));
+                    }
+
+                    if (!is_available) { break; }
+
+                    if (is_commutative(inst.op()))
+                    {
+                        std::sort(args.begin(), args.end());
+                    }
+
+                    for (auto& arg: args)
+                    {
+                        key.insert(key.end(), arg.begin(), arg.end());
+                    }
+
+                    auto [pos, is_new] = exprs.try_emplace(key, as_use(opnds[0]));
+
+                    if (is_new)
+                    {
+                        scope.push_back(std::move(key));
+                    }
+                    else
+                    {
+                        replace_def(*proc, inst, pos->second);
+                    }
+                }
+                }
+            }
+
+            mem_outs[bblock->idx()] = std::move(mem);
+
+            for (auto child: bblock->dom_children())
+            {
+                stack.push_back({ child, 0, false });
+            }
+        }
+    }
+}
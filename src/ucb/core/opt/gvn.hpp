@@ -0,0 +1,21 @@
+#pragma once
+
+#include <ucb/core/pass-manager.hpp>
+
+namespace ucb
+{
+    // global value numbering over the dominator tree. an instruction
+    // computing what a dominating one already computed is dropped and its
+    // uses read the earlier register instead. loads from frame slots are
+    // forwarded the value last stored to or loaded from the slot on the
+    // way from the closest block with several predecessors, and copies are
+    // propagated.
+    //
+    // only single def registers are numbered, see is_single_def. cmp is
+    // left alone so every brc still finds its cmp in its own block
+    class GlobalValueNumbering : public Pass
+    {
+    public:
+        void apply(std::shared_ptr<Procedure> proc) override;
+    };
+}
@@ -0,0 +1,281 @@
+#include <ucb/core/opt/mem2reg.hpp>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include <ucb/core/opt/rewrite.hpp>
+
+namespace ucb
+{
+    static bool is_promotable(RegisterID reg, const VirtualRegister& slot)
+    {
+        auto ty = slot.ty();
+
+        if (!ty_is_signed_int(ty) && !ty_is_unsigned_int(ty))
+        {
+            return false;
+        }
+
+        return std::all_of(slot.uses().begin(), slot.uses().end(), [&](auto inst)
+        {
+            auto& opnds = inst->opnds();
+
+            if (inst->ty() != ty)
+            {
+                return false;
+            }
+
+            return inst->op() == InstrOpcode::OP_LOAD
+                || (inst->op() == InstrOpcode::OP_STORE && opnds[1].get_virtual_reg() != reg);
+        });
+    }
+
+    // read before any store, defined as zero
+    static Operand undef(TypeID ty)
+    {
+        if (ty_is_signed_int(ty))
+        {
+            return Operand(0l, ty);
+        }
+
+        return Operand(0ul, ty);
+    }
+
+    void PromoteMemToReg::apply(std::shared_ptr<Procedure> proc)
+    {
+        proc->compute_predecessors();
+
+        struct Slot
+        {
+            RegisterID reg;
+            TypeID ty;
+            std::string_view name;
+        };
+
+        auto& symbols = proc->context()->symbols();
+        std::vector<Slot> slots;
+        // slot index by register
+        std::unordered_map<std::uint64_t, std::size_t> slot_idxs;
+
+        for (auto& [reg, vreg]: proc->frame())
+        {
+            if (is_promotable(reg, vreg))
+            {
+                slot_idxs.emplace(std::uint64_t{reg.val}, slots.size());
+                slots.push_back({ reg, vreg.ty(), symbols.name(vreg.id()) });
+            }
+        }
+
+        if (slots.empty())
+        {
+            return;
+        }
+
+        auto& bblocks = proc->bblocks();
+        auto size = bblocks.size();
+        auto frontiers = proc->dominance_frontiers();
+        auto new_version = [&](const Slot& slot)
+        {
+            auto id = "$" + std::string(slot.name) + "." + std::to_string(proc->regs().size());
+            return proc->add_vreg(symbols.intern(id), slot.ty);
+        };
+
+        auto is_reachable = [&](BasicBlock *bblock)
+        {
+            return bblock->idx() == 0 || bblock->idom() != nullptr;
+        };
+
+        // place phis
+        std::vector<std::vector<std::pair<std::size_t, Instruction*>>> phis(size);
+
+        for (std::size_t k = 0; k < slots.size(); ++k)
+        {
+            auto& slot = slots[k];
+            std::vector<bool> has_phi(size, false);
+            std::vector<bool> is_queued(size, false);
+            std::vector<BasicBlock*> worklist;
+
+            for (auto inst: proc->get_register(slot.reg)->uses())
+            {
+                auto bblock = inst->parent();
+
+                if (inst->is_store() && is_reachable(bblock) && !is_queued[bblock->idx()])
+                {
+                    is_queued[bblock->idx()] = true;
+                    worklist.push_back(bblock);
+                }
+            }
+
+            while (!worklist.empty())
+            {
+                auto bblock = worklist.back();
+                worklist.pop_back();
+
+                for (auto join: frontiers[bblock->idx()])
+                {
+                    auto idx = join->idx();
+
+                    if (has_phi[idx]) { continue; }
+
+                    auto& phi = join->prepend_instr(InstrOpcode::OP_PHI, slot.ty);
+                    phi.add_operand(Operand(new_version(slot), slot.ty, true));
+
+                    has_phi[idx] = true;
+                    phis[idx].emplace_back(k, &phi);
+
+                    if (!is_queued[idx])
+                    {
+                        is_queued[idx] = true;
+                        worklist.push_back(join);
+                    }
+                }
+            }
+        }
+
+        // rename, each slot has a stack of the values reaching the current
+        // block. pushed records which stacks to pop when a block is left
+        std::vector<std::vector<Operand>> stacks(slots.size());
+        std::vector<std::size_t> pushed;
+
+        auto top = [&](std::size_t k)
+        {
+            return stacks[k].empty() ? undef(slots[k].ty) : stacks[k].back();
+        };
+
+        auto push = [&](std::size_t k, const Operand& val)
+        {
+            stacks[k].push_back(as_use(val));
+            pushed.push_back(k);
+        };
+
+        auto slot_of = [&](const Operand& opnd) -> std::int64_t
+        {
+            auto it = slot_idxs.find(opnd.get_virtual_reg().val);
+            return it == slot_idxs.end() ? -1 : static_cast<std::int64_t>(it->second);
+        };
+
+        // loads and stores of a promoted slot are replaced or dropped, the
+        // value a store leaves in the slot is kept in a single def register
+        auto rewrite = [&](Instruction& inst, bool is_reachable)
+        {
+            auto& opnds = inst.opnds();
+
+            if (inst.op() == InstrOpcode::OP_LOAD)
+            {
+                auto k = slot_of(opnds[1]);
+
+                if (k != -1)
+                {
+                    replace_def(*proc, inst, is_reachable ? top(k) : undef(slots[k].ty));
+                }
+            }
+            else if (inst.op() == InstrOpcode::OP_STORE)
+            {
+                auto k = slot_of(opnds[0]);
+
+                if (k == -1) { return; }
+
+                auto val = opnds[1];
+
+                if (is_reachable && val.kind() == OperandKind::OK_VIRTUAL_REG
+                    && !is_single_def(*proc, val.get_virtual_reg()))
+                {
+                    auto bblock = inst.parent();
+                    auto& cp = bblock->insert_instr(bblock->insts().iterator_to(&inst), InstrOpcode::OP_CP, slots[k].ty);
+                    cp.add_operand(Operand(new_version(slots[k]), slots[k].ty, true));
+                    cp.add_operand(val);
+                    val = cp.opnds()[0];
+                }
+
+                if (is_reachable)
+                {
+                    push(k, val);
+                }
+
+                inst.erase_from_parent();
+            }
+        };
+
+        struct Visit
+        {
+            BasicBlock *bblock;
+            std::size_t pushed_size;
+            bool is_exit;
+        };
+
+        std::vector<Visit> stack;
+        stack.push_back({ &bblocks[0], 0, false });
+
+        while (!stack.empty())
+        {
+            auto visit = stack.back();
+            stack.pop_back();
+
+            if (visit.is_exit)
+            {
+                while (pushed.size() > visit.pushed_size)
+                {
+                    stacks[pushed.back()].pop_back();
+                    pushed.pop_back();
+                }
+
+                continue;
+            }
+
+            auto bblock = visit.bblock;
+            stack.push_back({ bblock, pushed.size(), true });
+
+            for (auto [k, phi]: phis[bblock->idx()])
+            {
+                push(k, phi->opnds()[0]);
+            }
+
+            auto& insts = bblock->insts();
+            auto it = insts.begin();
+
+            while (it != insts.end())
+            {
+                auto& inst = *it;
+                ++it;
+
+                rewrite(inst, true);
+            }
+
+            for (auto succ: bblock->successors())
+            {
+                for (auto [k, phi]: phis[succ->idx()])
+                {
+                    phi->add_operand(top(k));
+                    phi->add_operand(Operand(static_cast<int>(bblock->idx())));
+                }
+            }
+
+            for (auto child: bblock->dom_children())
+            {
+                stack.push_back({ child, 0, false });
+            }
+        }
+
+        // unreachable blocks may still name the slots
+        for (auto& bblock: bblocks)
+        {
+            if (is_reachable(&bblock)) { continue; }
+
+            auto& insts = bblock.insts();
+            auto it = insts.begin();
+
+            while (it != insts.end())
+            {
+                auto& inst = *it;
+                ++it;
+
+                rewrite(inst, false);
+            }
+        }
+
+        for (auto& slot: slots)
+        {
+            proc->remove_frame_slot(slot.reg);
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <ucb/core/pass-manager.hpp>
+
+namespace ucb
+{
+    // promotes integer frame slots that are only loaded from and stored to
+    // into registers. phis go on the iterated dominance frontiers of the
+    // blocks storing to a slot, as in Cytron et al., then loads are
+    // replaced by the value reaching them while walking the dominator tree
+    // and the stores are dropped along with the slot.
+    //
+    // the result has phis, OutOfSSA has to run before ISel
+    class PromoteMemToReg : public Pass
+    {
+    public:
+        void apply(std::shared_ptr<Procedure> proc) override;
+    };
+}
@@ -0,0 +1,54 @@
+#include <ucb/core/opt/out-of-ssa.hpp>
+
+#include <algorithm>
+
+#include <ucb/core/opt/rewrite.hpp>
+
+namespace ucb
+{
+    void OutOfSSA::apply(std::shared_ptr<Procedure> proc)
+    {
+        for (auto& bblock: proc->bblocks())
+        {
+            auto& insts = bblock.insts();
+            auto it = insts.begin();
+
+            // phis are always at the start of their block
+            while (it != insts.end() && it->op() == InstrOpcode::OP_PHI)
+            {
+                auto& phi = *it;
+                ++it;
+
+                auto& opnds = phi.opnds();
+                auto ty = phi.ty();
+                auto id = proc->context()->symbols().intern("$phi." + std::to_string(proc->regs().size()));
+                auto tmp = proc->add_vreg(id, ty);
+                std::vector<int> preds;
+
+                for (std::size_t i = 1; i + 1 < opnds.size(); i += 2)
+                {
+                    auto pred_idx = opnds[i + 1].get_bblock_idx();
+
+                    // a brc with both targets on this block
+                    if (std::find(preds.begin(), preds.end(), pred_idx) != preds.end())
+                    {
+                        continue;
+                    }
+
+                    preds.push_back(pred_idx);
+
+                    auto pred = proc->get_bblock(pred_idx);
+                    auto pos = pred->insts().iterator_to(&pred->insts().back());
+                    auto& cp = pred->insert_instr(pos, InstrOpcode::OP_CP, ty);
+                    cp.add_operand(Operand(tmp, ty, true));
+                    cp.add_operand(as_use(opnds[i]));
+                }
+
+                auto& cp = bblock.insert_instr(insts.iterator_to(&phi), InstrOpcode::OP_CP, ty);
+                cp.add_operand(opnds[0]);
+                cp.add_operand(Operand(tmp, ty, false));
+                phi.erase_from_parent();
+            }
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <ucb/core/pass-manager.hpp>
+
+namespace ucb
+{
+    // replaces every phi by copies. each phi gets a temporary written at
+    // the end of every predecessor and read into the phi's register where
+    // the phi was, so no edge has to be split and phis of the same block
+    // never see each other's new values. the register allocator coalesces
+    // most of the copies away
+    class OutOfSSA : public Pass
+    {
+    public:
+        void apply(std::shared_ptr<Procedure> proc) override;
+    };
+}
@@ -0,0 +1,66 @@
+#include <ucb/core/opt/rewrite.hpp>
+
+namespace ucb
+{
+    bool is_single_def(Procedure& proc, RegisterID reg)
+    {
+        auto vreg = proc.get_register(reg);
+
+        if (vreg == nullptr || proc.is_frame_slot(reg))
+        {
+            return false;
+        }
+
+        return vreg->defs().size() == (proc.is_param(reg) ? 0 : 1);
+    }
+
+    RegisterID def_of(Instruction& inst)
+    {
+        auto& opnds = inst.opnds();
+
+        if (opnds.empty() || !opnds[0].is_def())
+        {
+            return NO_REG;
+        }
+
+        return opnds[0].get_virtual_reg();
+    }
+
+    Operand as_use(const Operand& opnd)
+    {
+        if (opnd.kind() == OperandKind::OK_VIRTUAL_REG)
+        {
+            return Operand(opnd.get_virtual_reg(), opnd.ty(), false);
+        }
+
+        return opnd;
+    }
+
+    void replace_def(Procedure& proc, Instruction& inst, const Operand& value)
+    {
+        auto def = inst.opnds()[0];
+        auto reg = def.get_virtual_reg();
+        assert(def.is_def());
+
+        if (value.get_virtual_reg() == reg)
+        {
+            inst.erase_from_parent();
+        }
+        else if (is_single_def(proc, reg))
+        {
+            proc.replace_all_uses_with(reg, value);
+            inst.erase_from_parent();
+        }
+        else
+        {
+            auto bblock = inst.parent();
+            auto pos = bblock->insts().iterator_to(&inst);
+            auto& cp = bblock->insert_instr(pos, InstrOpcode::OP_CP, def.ty());
+
+            cp.add_operand(def);
+            cp.add_operand(as_use(value));
+
+            inst.erase_from_parent();
+        }
+    }
+}
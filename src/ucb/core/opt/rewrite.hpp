@@ -0,0 +1,23 @@
+#pragma once
+
+#include <ucb/core/ir/procedure.hpp>
+
+namespace ucb
+{
+    // the ir is not in ssa form, a register reads the same value anywhere
+    // it is used only if it is a parameter that is never written or a
+    // register with a single def. those are the ones passes reason about
+    bool is_single_def(Procedure& proc, RegisterID reg);
+
+    // the register an instruction writes, NO_REG if none
+    RegisterID def_of(Instruction& inst);
+
+    // the same operand, reading its register if it is a def
+    Operand as_use(const Operand& opnd);
+
+    // makes the value inst defines come from value instead. a single def
+    // register is replaced on every use and inst erased, any other one is
+    // written by a copy put in place of inst. def-use lists must be up to
+    // date
+    void replace_def(Procedure& proc, Instruction& inst, const Operand& value);
+}
@@ -1,17 +1,193 @@
 #include <ucb/core/pass-manager.hpp>
 
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+
+#include <ucb/core/bounded-queue.hpp>
+
 namespace  ucb
 {
+    // procedures in flight per worker when streaming, the slack lets later
+    // procedures finish while an earlier, bigger one is still compiling
+    constexpr std::size_t STREAM_WINDOW_PER_WORKER = 4;
+
     void PassManager::apply(std::shared_ptr<CompileUnit> unit, const std::string& src_file, std::ostream& output)
     {
-        for (auto& pass: _passes)
+        auto begin = _passes.begin();
+
+        while (begin != _passes.end())
         {
-            for(auto& proc: unit->procs())
+            // the procedure passes up to the next module pass form one stage
+            auto end = std::find_if(begin, _passes.end(), [](auto& pass)
+            {
+                return pass->kind() == PassKind::PK_MODULE;
+            });
+
+            run_pipeline(*unit, begin, end);
+
+            if (end == _passes.end())
+            {
+                break;
+            }
+
+            for (auto& proc: unit->procs())
             {
-                pass->apply(proc);
+                (*end)->apply(proc);
             }
+
+            begin = std::next(end);
         }
 
-        _target->compile(unit, std::move(src_file), output);
+        _target->compile(std::move(unit), src_file, output);
+    }
+
+    void PassManager::run_pipeline(CompileUnit& unit, PassIt begin, PassIt end)
+    {
+        if (begin == end)
+        {
+            return;
+        }
+
+        auto& procs = unit.procs();
+
+        auto run = [&](std::size_t i)
+        {
+            for (auto it = begin; it != end; ++it)
+            {
+                (*it)->apply(procs[i]);
+            }
+        };
+
+        if (_pool != nullptr)
+        {
+            _pool->parallel_for(procs.size(), run);
+        }
+        else
+        {
+            for (std::size_t i = 0; i < procs.size(); ++i)
+            {
+                run(i);
+            }
+        }
+    }
+
+    bool PassManager::stream(
+        std::shared_ptr<CompileUnit> unit,
+        const std::function<bool(const ProcSink&)>& produce,
+        const std::string& src_file,
+        std::ostream& output)
+    {
+        auto has_module_pass = std::any_of(_passes.begin(), _passes.end(), [](auto& pass)
+        {
+            return pass->kind() == PassKind::PK_MODULE;
+        });
+
+        if (has_module_pass)
+        {
+            if (!produce([&](std::shared_ptr<Procedure> proc) { unit->add_procedure(std::move(proc)); }))
+            {
+                return false;
+            }
+
+            apply(std::move(unit), src_file, output);
+            return true;
+        }
+
+        // the unit never holds the procedures, so duplicates are caught here
+        std::unordered_set<SymbolID> seen;
+
+        auto check_unique = [&](Procedure& proc)
+        {
+            if (!seen.insert(proc.id()).second)
+            {
+                std::cerr << "procedure \"" << proc.name() << "already exists\n";
+                abort();
+            }
+        };
+
+        _target->begin_asm(src_file, output);
+
+        if (_pool == nullptr || _pool->size() < 2)
+        {
+            return produce([&](std::shared_ptr<Procedure> proc)
+            {
+                check_unique(*proc);
+
+                for (auto& pass: _passes)
+                {
+                    pass->apply(proc);
+                }
+
+                proc->dump(std::cout);
+                _target->compile_procedure(proc, true);
+                _target->emit(*proc, output);
+            });
+        }
+
+        // worker 0 produces into work, the others compile and print whatever
+        // is next in order. done holds the procedures that finished before
+        // one that comes earlier, the window keeps it from growing
+        auto window = STREAM_WINDOW_PER_WORKER * _pool->size();
+        BoundedQueue<std::pair<std::size_t, std::shared_ptr<Procedure>>> work(_pool->size());
+
+        std::mutex emit_mutex;
+        std::condition_variable emitted_cv;
+        std::map<std::size_t, std::shared_ptr<Procedure>> done;
+        std::size_t emitted = 0;
+        auto ok = true;
+
+        _pool->parallel_for(_pool->size(), [&](std::size_t i)
+        {
+            if (i == 0)
+            {
+                std::size_t seq = 0;
+
+                ok = produce([&](std::shared_ptr<Procedure> proc)
+                {
+                    check_unique(*proc);
+
+                    {
+                        std::unique_lock lock(emit_mutex);
+                        emitted_cv.wait(lock, [&] { return seq - emitted < window; });
+                    }
+
+                    work.push({ seq++, std::move(proc) });
+                });
+
+                work.close();
+                return;
+            }
+
+            std::pair<std::size_t, std::shared_ptr<Procedure>> item;
+
+            while (work.pop(item))
+            {
+                // debug dumps would interleave, so workers run quietly
+                for (auto& pass: _passes)
+                {
+                    pass->apply(item.second);
+                }
+
+                _target->compile_procedure(item.second, false);
+
+                std::lock_guard lock(emit_mutex);
+                done.emplace(item.first, std::move(item.second));
+
+                for (auto it = done.begin(); it != done.end() && it->first == emitted; it = done.erase(it))
+                {
+                    _target->emit(*it->second, output);
+                    ++emitted;
+                }
+
+                emitted_cv.notify_one();
+            }
+        });
+
+        output.flush();
+        return ok;
     }
 }
@@ -1,33 +1,70 @@
 #pragma once
 
+#include <functional>
+
 #include <ucb/core/target-machine.hpp>
+#include <ucb/core/thread-pool.hpp>
 #include <ucb/core/ir/procedure.hpp>
 
 namespace ucb
 {
+    enum PassKind
+    {
+        // only reads and writes the procedure it is applied to
+        PK_PROCEDURE,
+        // looks at other procedures of the unit, every procedure has to be
+        // done with the passes before it and it is applied serially
+        PK_MODULE
+    };
+
     class Pass
     {
     public:
         virtual void apply(std::shared_ptr<Procedure> proc) = 0;
 
+        virtual PassKind kind() const { return PassKind::PK_PROCEDURE; }
+
         virtual ~Pass() = default;
     };
 
+    // runs procedure passes procedure-major, so each procedure goes through
+    // the whole pipeline while it is still in cache. with a pool, procedures
+    // go through it concurrently and the only barriers are module passes and
+    // the final code generation
     class PassManager
     {
     public:
         PassManager(
                 std::vector<std::unique_ptr<Pass>> passes,
-                std::unique_ptr<TargetMachine> target):
+                std::unique_ptr<TargetMachine> target,
+                std::shared_ptr<ThreadPool> pool = nullptr):
             _passes(std::move(passes)),
-            _target(std::move(target))
+            _target(std::move(target)),
+            _pool(std::move(pool))
         {
         }
 
         void apply(std::shared_ptr<CompileUnit> unit, const std::string& src_file, std::ostream& output);
 
+        // produce hands procedures of unit to its sink as they are made,
+        // each one goes through the passes and code generation right away
+        // and is printed and released once every procedure before it is.
+        // with a pool, making, compiling and printing overlap and only a
+        // few procedures per worker are alive at a time. module passes need
+        // every procedure, with any of them this is produce then apply
+        bool stream(
+            std::shared_ptr<CompileUnit> unit,
+            const std::function<bool(const ProcSink&)>& produce,
+            const std::string& src_file,
+            std::ostream& output);
+
     private:
+        using PassIt = std::vector<std::unique_ptr<Pass>>::iterator;
+
         std::vector<std::unique_ptr<Pass>> _passes;
         std::unique_ptr<TargetMachine> _target;
+        std::shared_ptr<ThreadPool> _pool;
+
+        void run_pipeline(CompileUnit& unit, PassIt begin, PassIt end);
     };
 }
@@ -3,27 +3,30 @@
 #include <iostream>
 
 #include <ucb/core/regalloc/interference-graph.hpp>
+#include <ucb/core/regalloc/spill.hpp>
 
 namespace  ucb
 {
     void GraphColoringRegAlloc::run_on_procedure(std::shared_ptr<Procedure> proc, bool debug)
     {
-        auto reg_classes = _target->load_reg_classes();
+        auto& reg_classes = _target->load_reg_classes();
 
         if (debug)
         {
-            std::cout << "register allocation for procedure: " << proc->id() << "\n\n";
+            std::cout << "register allocation for procedure: " << proc->name() << "\n\n";
         }
 
+        // temporaries made by spilling, spilling them again gains nothing
+        std::set<RegisterID> no_spill;
+
         for (auto& reg_class: reg_classes)
         {
             while (true)
             {
                 // build
                 auto k = reg_class.physical_regs.size();
-                auto ig = build_interference_graph(*proc, reg_class.tys, _target);
-                std::vector<IGNode> stack;
-                std::vector<RegisterID> spills;
+                auto ig = build_interference_graph(*proc, reg_class.tys, no_spill, _target);
+                std::set<RegisterID> spills;
 
                 if (debug)
                 {
@@ -31,111 +34,44 @@ namespace  ucb
                     ig.dump();
                 }
 
-                while (!ig.empty())
-                {
-                    // simplify
-                    while (true)
-                    {
-                        //std::cout << "simplify" << std::endl;
-                        auto n = ig.pop_node(k);
+                ig.make_worklists(k);
 
-                        if (n.has_value())
-                        {
-                            //std::cout << "popped node:" << std::endl;
-                            std::cout << "simplify" << std::endl;
-                            ig.dump();
-                            stack.push_back(std::move(n.value()));
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
-
-                    // coalesce
-                    auto [coalesce_res, mvs] = ig.coalesce(k);
-
-                    if (coalesce_res)
-                    {
-                        std::cout << "coalesced removing " << mvs.size() << " moves:" << std::endl;
-                        ig.dump();
-
-                        for (auto ptr: mvs)
-                        {
-                            for (auto& bblock: proc->bblocks())
-                            {
-                                auto& insts = bblock.machine_insts();
-                                auto it = std::find_if(
-                                    insts.begin(),
-                                    insts.end(),
-                                    [ptr](auto& inst)
-                                    {
-                                        return &inst == ptr;
-                                    });
-
-                                if (it != insts.end())
-                                {
-                                    insts.erase(it);
-                                    break;
-                                }
-                            }
-
-                            //std::cout << "proc after removeing moves:\n";
-                            //_target->dump_proc(*proc, std::cout);
-                        }
-                    }
-                    // freeze
-                    else if (!ig.freeze_move())
-                    {
-                        //std::cout << "potential spill?" << std::endl;
-                        // potential spill
-                        if (!ig.empty() && !ig.can_simplify())
-                        {
-                            //std::cout << "potential spill!" << std::endl;
-                            auto n = ig.pop_highest_degree();
-                            stack.push_back(std::move(n.value()));
-                        }
-                    }
+                while (ig.simplify() || ig.coalesce() || ig.freeze() || ig.select_spill())
+                {
                 }
 
-                //std::cout << "select phase" << std::endl;
-
                 // select
+                auto& stack = ig.select_stack();
+
                 while (!stack.empty())
                 {
-                    auto n = std::move(stack.back());
+                    auto idx = stack.back();
                     stack.pop_back();
 
+                    auto& n = ig.node(idx);
                     auto phys_reg = NO_REG;
 
-                    if (n.physical_register != NO_REG)
-                    {
-                        phys_reg = n.physical_register;
-                    }
-                    else
+                    for (auto reg: reg_class.physical_regs)
                     {
-                        for (auto reg: reg_class.physical_regs)
-                        {
-                            auto is_selected = false;
-
-                            for (auto i: n.interferences)
-                            {
-                                auto& in = ig.get(i);
+                        auto is_selected = false;
 
-                                if (in.physical_register == reg)
-                                {
-                                    is_selected = true;
-                                    break;
-                                }
-                            }
+                        for (auto i: n.adj)
+                        {
+                            auto& in = ig.node(ig.find(i));
 
-                            if (!is_selected)
+                            if (in.physical_register.val == reg.val)
                             {
-                                phys_reg = reg;
-                                phys_reg.size = n.keys.begin()->size;
+                                is_selected = true;
                                 break;
                             }
                         }
+
+                        if (!is_selected)
+                        {
+                            phys_reg = reg;
+                            phys_reg.size = n.reg.size;
+                            break;
+                        }
                     }
 
                     // successful selection
@@ -146,40 +82,55 @@ namespace  ucb
                     else
                     // actual spill
                     {
-                        if (n.keys.size() != 1)
+                        if (n.no_spill)
                         {
-                            //std::cerr << "merged a node of significant degree" << std::endl;
+                            std::cerr << "no register left for a spill temporary" << std::endl;
                             abort();
                         }
 
-                        spills.push_back(*n.keys.begin());
+                        // the moves between coalesced registers are still
+                        // in the code, so each of them is spilled on its own
+                        for (std::uint32_t i = 0; i < ig.size(); ++i)
+                        {
+                            if (ig.find(i) == idx)
+                            {
+                                spills.insert(ig.node(i).reg);
+                            }
+                        }
                     }
-
-                    ig.push_node(std::move(n));
                 }
 
-                std::cout << "ig after selection:\n";
-                ig.dump();
+                if (debug)
+                {
+                    std::cout << "ig after selection:\n";
+                    ig.dump();
+                }
 
                 // successful selection for all instructions
                 if (spills.empty())
                 {
+                    // moves are only dropped once the whole graph is
+                    // colored, spilling rebuilds it from the code as it is
+                    for (auto ptr: ig.coalesced_moves())
+                    {
+                        ptr->parent()->machine_insts().erase(ptr);
+                    }
+
                     select_registers(*proc, ig);
                     break;
                 }
                 // handle spills and try again
                 else
                 {
-                    std::cerr << "spills are not implemented yet" << std::endl;
-                    abort();
-                    // handle_spills(proc, spills);
+                    insert_spill_code(*proc, *_target, spills, no_spill);
+                    proc->compute_machine_lifetimes();
                 }
             }
         }
 
         if (debug)
         {
-            std::cout << "procedure " << proc->id() << " after register allocation\n\n";
+            std::cout << "procedure " << proc->name() << " after register allocation\n\n";
 
             for (auto& bblock: proc->bblocks())
             {
@@ -192,11 +143,12 @@ namespace  ucb
     {
         for (auto& bblock: proc.bblocks())
         {
-            //std::cout << "select on bblock" << std::endl;
+            auto& insts = bblock.machine_insts();
+            auto it = insts.begin();
 
-            for (auto& inst: bblock.machine_insts())
+            while (it != insts.end())
             {
-                for (auto& opnd: inst.opnds)
+                for (auto& opnd: it->opnds)
                 {
                     if (opnd.kind != MachineOperand::Register) { continue; }
 
@@ -204,11 +156,28 @@ namespace  ucb
 
                     if (!is_physical_reg(reg))
                     {
-                        auto p = ig.get(reg).physical_register;
-                        //std::cout << "reg " << reg.val << " phys " << p.val << std::endl;
+                        auto p = ig.node_of(reg).physical_register;
+                        p.size = reg.size;
                         opnd.val = std::bit_cast<std::uint64_t>(p);
                     }
                 }
+
+                // moves that were not coalesced may still have landed in
+                // the same register
+                auto is_noop = _target->is_rr_move(it->opc)
+                    && it->opnds.size() == 2
+                    && it->opnds[0].kind == MachineOperand::Register
+                    && it->opnds[1].kind == MachineOperand::Register
+                    && it->opnds[0].val == it->opnds[1].val;
+
+                if (is_noop)
+                {
+                    it = insts.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
             }
         }
     }
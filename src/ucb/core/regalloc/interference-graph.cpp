@@ -1,431 +1,540 @@
 #include <ucb/core/regalloc/interference-graph.hpp>
 
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <optional>
+
 namespace ucb
 {
-    bool IGNode::interferes_with(const IGNode& other)
+    std::uint32_t InterferenceGraph::get(RegisterID key)
     {
-        for (auto key: other.keys)
+        if (key.val >= _node_idxs.size())
         {
-            auto it = std::find(interferences.begin(), interferences.end(), key);
+            _node_idxs.resize(key.val + 1, -1);
+        }
 
-            if (it != interferences.end())
-            {
-                return true;
-            }
+        if (_node_idxs[key.val] != -1)
+        {
+            return _node_idxs[key.val];
         }
 
-        return false;
-    }
+        std::uint32_t idx = _nodes.size();
+        _node_idxs[key.val] = idx;
 
-    void IGNode::dump()
-    {
-        std::cout << "\tkeys: { ";
-        std::string junc = "";
+        _nodes.push_back({
+            .reg = key,
+            .alias = idx
+        });
 
-        for (auto key: keys)
+        if (is_physical_reg(key))
         {
-            std::cout << junc << key.val;
-            junc = ", ";
+            _nodes.back().physical_register = key;
+            _nodes.back().state = NS_PRECOLORED;
         }
 
-        std::cout << " }, interferences: { ";
-        junc = "";
+        _matrix.resize((_bit(idx + 1, 0) + 63) / 64, 0);
+        _marks.push_back(0);
+        return idx;
+    }
 
-        for (auto interference: interferences)
+    std::uint32_t InterferenceGraph::find(std::uint32_t idx)
+    {
+        auto root = idx;
+
+        while (_nodes[root].alias != root)
         {
-            std::cout << junc << interference.val;
-            junc = ", ";
+            root = _nodes[root].alias;
         }
 
-        std::cout << " }, moves: ";
-        junc = "";
-
-        for (auto mv: moves)
+        // path compression
+        while (_nodes[idx].alias != root)
         {
-            std::cout << junc << mv;
-            junc = ", ";
+            auto next = _nodes[idx].alias;
+            _nodes[idx].alias = root;
+            idx = next;
         }
 
-        if (physical_register != NO_REG)
+        return root;
+    }
+
+    IGNode& InterferenceGraph::node_of(RegisterID key)
+    {
+        if (key.val >= _node_idxs.size() || _node_idxs[key.val] == -1)
         {
-            std::cout << ", physical reg: " << physical_register.val;
+            std::cerr << "register " << key.val << " is not on the interference graph" << std::endl;
+            abort();
         }
 
-        std::cout << std::endl;
+        return _nodes[find(_node_idxs[key.val])];
     }
 
-    bool InterferenceGraph::is_interference(RegisterID a, RegisterID b)
+    std::uint64_t InterferenceGraph::_bit(std::uint32_t a, std::uint32_t b)
     {
-        auto node_a = std::find_if(nodes.begin(), nodes.end(), [&](auto& n)
+        if (a < b)
         {
-            auto it = std::find(n.keys.begin(), n.keys.end(), a);
-            return it != n.keys.end();
-        });
+            std::swap(a, b);
+        }
+
+        return std::uint64_t{a} * (a - 1) / 2 + b;
+    }
 
-        if (node_a == nodes.end())
+    bool InterferenceGraph::is_interference(std::uint32_t a, std::uint32_t b) const
+    {
+        if (a == b)
         {
             return false;
         }
 
-        auto node_b = std::find_if(nodes.begin(), nodes.end(), [&](auto& n)
+        auto bit = _bit(a, b);
+        return (_matrix[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    void InterferenceGraph::add_interference(std::uint32_t a, std::uint32_t b)
+    {
+        if (a == b || is_interference(a, b))
         {
-            auto it = std::find(n.keys.begin(), n.keys.end(), b);
-            return it != n.keys.end();
-        });
+            return;
+        }
+
+        auto bit = _bit(a, b);
+        _matrix[bit / 64] |= std::uint64_t{1} << (bit % 64);
 
-        if (node_a == nodes.end())
+        for (auto [n, other]: { std::pair{ a, b }, std::pair{ b, a } })
         {
-            return false;
+            if (_nodes[n].state != NS_PRECOLORED)
+            {
+                _nodes[n].adj.push_back(other);
+                ++_nodes[n].degree;
+            }
         }
+    }
 
-        return node_a->interferes_with(*node_b);
+    void InterferenceGraph::add_move(MachineInstruction *inst, std::uint32_t a, std::uint32_t b)
+    {
+        std::uint32_t idx = _moves.size();
+        _moves.push_back({ inst, a, b });
+        _nodes[a].moves.push_back(idx);
+        _nodes[b].moves.push_back(idx);
+        _move_worklist.push_back(idx);
     }
 
-    void InterferenceGraph::add_interference(RegisterID a, RegisterID b)
+    std::uint32_t InterferenceGraph::_next_mark()
     {
-        if (a != b && !is_interference(a, b))
+        if (++_mark == 0)
         {
-            //std::cout << "add interference " << a.val << " and " << b.val << std::endl;
-            auto& node_a = get(a);
-            node_a.interferences.insert(b);
-
-            auto& node_b = get(b);
-            node_b.interferences.insert(a);
+            std::fill(_marks.begin(), _marks.end(), 0);
+            _mark = 1;
         }
+
+        return _mark;
     }
 
-    IGNode& InterferenceGraph::get(RegisterID key)
+    bool InterferenceGraph::is_move_related(std::uint32_t idx)
     {
-        auto node = std::find_if(nodes.begin(), nodes.end(), [&](auto& n)
+        for (auto mv: _nodes[idx].moves)
         {
-            return n.keys.contains(key);
-            //auto it = std::find(n.keys.begin(), n.keys.end(), key);
-            //return it != n.keys.end();
-        });
+            if (_moves[mv].state == MS_WORKLIST || _moves[mv].state == MS_ACTIVE)
+            {
+                return true;
+            }
+        }
 
-        if (node == nodes.end())
-        {
-            //std::cout << "new node" << std::endl;
-            nodes.push_back({
-                .keys = { key }
-            });
+        return false;
+    }
+
+    bool InterferenceGraph::_is_significant(std::uint32_t idx) const
+    {
+        return _nodes[idx].state == NS_PRECOLORED || _nodes[idx].degree >= _k;
+    }
+
+    // neighbors that were simplified or coalesced away no longer count,
+    // coalescing adds their representative to the list on its own
+    bool InterferenceGraph::_is_adjacent(std::uint32_t idx) const
+    {
+        return _nodes[idx].state != NS_SELECT && _nodes[idx].state != NS_COALESCED;
+    }
 
-            auto& res = nodes.back();
+    bool InterferenceGraph::briggs(std::uint32_t a, std::uint32_t b)
+    {
+        auto mark = _next_mark();
+        auto significant = 0;
 
-            if (is_physical_reg(key))
+        for (auto node: { a, b })
+        {
+            for (auto n: _nodes[node].adj)
             {
-                res.physical_register = key;
+                if (_marks[n] == mark || !_is_adjacent(n)) { continue; }
+
+                _marks[n] = mark;
+
+                if (_is_significant(n))
+                {
+                    ++significant;
+                }
             }
+        }
 
-            return res;
+        return significant < _k;
+    }
+
+    bool InterferenceGraph::george(std::uint32_t a, std::uint32_t b)
+    {
+        for (auto n: _nodes[b].adj)
+        {
+            if (_is_adjacent(n) && _is_significant(n) && _nodes[n].state != NS_PRECOLORED && !is_interference(n, a))
+            {
+                return false;
+            }
         }
-        else
+
+        return true;
+    }
+
+    void InterferenceGraph::_set_state(std::uint32_t idx, NodeState state)
+    {
+        _nodes[idx].state = state;
+
+        switch (state)
         {
-            return *node;
+        case NS_SIMPLIFY:
+            _simplify_worklist.push_back(idx);
+            break;
+        case NS_FREEZE:
+            _freeze_worklist.push_back(idx);
+            break;
+        case NS_SPILL:
+            _spill_worklist.push_back(idx);
+            break;
+        case NS_SELECT:
+            _select_stack.push_back(idx);
+            break;
+        default:
+            break;
         }
     }
 
-    int InterferenceGraph::get_neighbor_count(IGNode& node, int k)
+    void InterferenceGraph::make_worklists(int k)
     {
-        std::set<IGNode*> neighbors;
+        _k = k;
 
-        for (auto key: node.interferences)
+        for (std::uint32_t idx = 0; idx < _nodes.size(); ++idx)
         {
-            auto& i = get(key);
+            if (_nodes[idx].state != NS_INITIAL) { continue; }
 
-            if (i.interferences.size() >= k && !neighbors.contains(&i))
+            if (_nodes[idx].degree >= k)
+            {
+                _set_state(idx, NS_SPILL);
+            }
+            else if (is_move_related(idx))
+            {
+                _set_state(idx, NS_FREEZE);
+            }
+            else
             {
-                neighbors.insert(&i);
+                _set_state(idx, NS_SIMPLIFY);
             }
         }
-
-        return neighbors.size();
     }
 
-    bool InterferenceGraph::briggs(IGNode& a, IGNode& b, int k)
+    void InterferenceGraph::_enable_moves(std::uint32_t idx)
     {
-        std::set<IGNode*> neighbors;
-
-        if (a.interferes_with(b)) { return false; }
-
-        for (auto key: a.interferences)
+        for (auto mv: _nodes[idx].moves)
         {
-            auto& i = get(key);
-
-            if (i.interferences.size() >= k && !neighbors.contains(&i))
+            if (_moves[mv].state == MS_ACTIVE)
             {
-                neighbors.insert(&i);
+                _moves[mv].state = MS_WORKLIST;
+                _move_worklist.push_back(mv);
             }
         }
+    }
+
+    void InterferenceGraph::_decrement_degree(std::uint32_t idx)
+    {
+        auto& node = _nodes[idx];
 
-        for (auto key: b.interferences)
+        if (node.state == NS_PRECOLORED || node.degree-- != _k)
         {
-            auto& i = get(key);
+            return;
+        }
 
-            if (i.interferences.size() >= k && !neighbors.contains(&i))
+        // dropping below k may let the moves of the node and its neighbors
+        // pass the coalescing tests
+        _enable_moves(idx);
+
+        for (auto n: node.adj)
+        {
+            if (_is_adjacent(n))
             {
-                neighbors.insert(&i);
+                _enable_moves(n);
             }
         }
 
-        return neighbors.size() < k;
+        _set_state(idx, is_move_related(idx) ? NS_FREEZE : NS_SIMPLIFY);
     }
 
-    bool InterferenceGraph::empty()
+    void InterferenceGraph::_add_worklist(std::uint32_t idx)
     {
-        return nodes.empty();
+        auto& node = _nodes[idx];
+
+        if (node.state == NS_FREEZE && !is_move_related(idx) && node.degree < _k)
+        {
+            _set_state(idx, NS_SIMPLIFY);
+        }
     }
 
-    bool InterferenceGraph::can_simplify()
+    bool InterferenceGraph::simplify()
     {
-        if (nodes.empty()) { return false; }
+        while (!_simplify_worklist.empty())
+        {
+            auto idx = _simplify_worklist.back();
+            _simplify_worklist.pop_back();
 
-        auto it = std::find_if(
-            nodes.begin(),
-            nodes.end(),
-            [](auto& n){ return n.moves.empty(); });
+            // stale entry, the node moved to another list since
+            if (_nodes[idx].state != NS_SIMPLIFY) { continue; }
 
-        return it != nodes.end();
-    }
-/*
-    bool InterferenceGraph::can_coalesce()
-    {
-        if (nodes.empty()) { return false; }
+            _set_state(idx, NS_SELECT);
+
+            for (auto n: _nodes[idx].adj)
+            {
+                if (_is_adjacent(n))
+                {
+                    _decrement_degree(n);
+                }
+            }
 
-        auto it = std::find_if(
-            nodes.begin(),
-            nodes.end(),
-            [](auto& n){ return n.moves.empty(); });
+            return true;
+        }
 
-        return it == nodes.end();
+        return false;
     }
-*/
-    std::pair<bool, std::set<MachineInstruction*>> InterferenceGraph::coalesce(int k)
+
+    void InterferenceGraph::_combine(std::uint32_t a, std::uint32_t b)
     {
-        std::set<MachineInstruction*> res;
-        if (nodes.empty()) { return std::make_pair(false, res); }
+        auto& node_b = _nodes[b];
 
-        //std::cout << "coalesce" << std::endl;
+        node_b.state = NS_COALESCED;
+        node_b.alias = a;
 
-        auto it = nodes.begin();
+        _nodes[a].moves.insert(_nodes[a].moves.end(), node_b.moves.begin(), node_b.moves.end());
+        _enable_moves(b);
 
-        while (it != nodes.end())
+        for (auto n: node_b.adj)
         {
-            //std::cout << "loop" << std::endl;
-
-            if (!it->moves.empty())
+            if (_is_adjacent(n))
             {
-                //std::cout << "node has moves" << std::endl;
+                add_interference(n, a);
+                _decrement_degree(n);
+            }
+        }
 
-                for (auto mv: it->moves)
-                {
-                    //std::cout << "loop 2" << std::endl;
+        auto& node_a = _nodes[a];
 
-                    // TODO will crash when a node is skipped
-                    auto itb = std::find_if(
-                        it + 1,
-                        nodes.end(),
-                        [mv](auto& n)
-                        {
-                            //auto itc = std::find(n.moves.begin(), n.moves.end(), mv);
-                            //return itc != n.moves.end();
-                            return n.moves.contains(mv);
-                        });
+        if (node_a.state == NS_FREEZE && node_a.degree >= _k)
+        {
+            _set_state(a, NS_SPILL);
+        }
 
-                    if (itb == nodes.end())
-                    {
-                        std::cerr << "reference to move instruction appears only once" << std::endl;
-                        abort();
-                    }
+        node_a.spill_cost += node_b.spill_cost;
+        node_a.no_spill = node_a.no_spill || node_b.no_spill;
+    }
 
-                    // if the two registers interfere with each other we will never be able to merge them
-                    if (it->interferes_with(*itb))
-                    {
-                        it->moves.erase(mv);
-                        itb->moves.erase(mv);
-                        continue;
-                    }
+    bool InterferenceGraph::coalesce()
+    {
+        while (!_move_worklist.empty())
+        {
+            auto mv = _move_worklist.back();
+            _move_worklist.pop_back();
 
-                    // check if both nodes are already colored
-                    if (it->physical_register != NO_REG
-                        && itb->physical_register != NO_REG)
-                    {
-                        //std::cout << "phys regs" << std::endl;
-                        it->moves.erase(mv);
-                        itb->moves.erase(mv);
-                        return std::make_pair(true, res);
-                    }
+            auto& move = _moves[mv];
 
-                    if (briggs(*it, *itb, k))
-                    {
-                        // merge the two nodes
-                        it->keys.merge(std::move(itb->keys));
-                        it->interferences.merge(std::move(itb->interferences));
+            if (move.state != MS_WORKLIST) { continue; }
 
-                        // remove any common moves
-                        auto m = it->moves.begin();
-                        while (m != it->moves.end())
-                        {
-                            if (itb->moves.contains(*m))
-                            {
-                                res.insert(*m);
-                                itb->moves.erase(*m);
-                                m = it->moves.erase(m);
-                            }
-                            else
-                            {
-                                ++m;
-                            }
-                        }
+            // a precolored end always stays the representative
+            auto a = find(move.a);
+            auto b = find(move.b);
 
-                        // must be after removing common moves
-                        it->moves.merge(std::move(itb->moves));
-
-                        if (itb->physical_register != NO_REG)
-                        {
-                            it->physical_register = itb->physical_register;
-                        }
+            if (_nodes[b].state == NS_PRECOLORED)
+            {
+                std::swap(a, b);
+            }
 
-                        nodes.erase(itb);
-                        return std::make_pair(true, res);
-                    }
-                }
+            if (a == b)
+            {
+                move.state = MS_COALESCED;
+                _add_worklist(a);
+            }
+            else if (_nodes[b].state == NS_PRECOLORED || is_interference(a, b))
+            {
+                move.state = MS_CONSTRAINED;
+                _add_worklist(a);
+                _add_worklist(b);
+            }
+            else if (_nodes[a].state == NS_PRECOLORED ? george(a, b) : briggs(a, b))
+            {
+                move.state = MS_COALESCED;
+                _combine(a, b);
+                _add_worklist(a);
+            }
+            else
+            {
+                move.state = MS_ACTIVE;
             }
 
-            ++it;
+            return true;
         }
 
-        return std::make_pair(false, res);
+        return false;
     }
 
-    bool InterferenceGraph::freeze_move()
+    void InterferenceGraph::_freeze_moves(std::uint32_t idx)
     {
-        if (nodes.empty()) { return false; }
-
-        auto it = nodes.begin();
+        auto rep = find(idx);
 
-        while (it != nodes.end())
+        for (auto mv: _nodes[idx].moves)
         {
-            if (!it->moves.empty())
-            {
-                for (auto mv: it->moves)
-                {
-                    auto itb = std::find_if(
-                        it + 1,
-                        nodes.end(),
-                        [mv](auto& n)
-                        {
-                            //auto itc = std::find(n.moves.begin(), n.moves.end(), mv);
-                            //return itc != n.moves.end();
-                            return n.moves.contains(mv);
-                        });
+            auto& move = _moves[mv];
 
-                    if (itb == nodes.end())
-                    {
-                        std::cerr << "reference to move instruction appears only once" << std::endl;
-                        abort();
-                    }
+            if (move.state != MS_ACTIVE && move.state != MS_WORKLIST) { continue; }
 
-                    it->moves.erase(mv);
-                    itb->moves.erase(mv);
-                    return true;
-                }
+            move.state = MS_FROZEN;
+
+            auto other = find(move.a) == rep ? find(move.b) : find(move.a);
+            auto& node = _nodes[other];
+
+            if (node.state == NS_FREEZE && !is_move_related(other) && node.degree < _k)
+            {
+                _set_state(other, NS_SIMPLIFY);
             }
         }
+    }
+
+    bool InterferenceGraph::freeze()
+    {
+        while (!_freeze_worklist.empty())
+        {
+            auto idx = _freeze_worklist.back();
+            _freeze_worklist.pop_back();
+
+            if (_nodes[idx].state != NS_FREEZE) { continue; }
+
+            // give up coalescing the node so simplify can take it
+            _set_state(idx, NS_SIMPLIFY);
+            _freeze_moves(idx);
+            return true;
+        }
 
         return false;
     }
 
-    // TODO select colored nodes last
-    std::optional<IGNode> InterferenceGraph::pop_node(int k)
+    bool InterferenceGraph::select_spill()
     {
-        if (nodes.empty())
-            return std::nullopt;
-
-        auto it = nodes.begin();
-        auto selected = nodes.end();
-        auto degree = -1;
+        std::optional<std::uint32_t> selected;
+        auto best = 0.0f;
+        std::size_t kept = 0;
 
-        while (it != nodes.end())
+        // nodes that must not be spilled only go when nothing else is left,
+        // select may still find them a color
+        for (auto idx: _spill_worklist)
         {
-            int it_degree = it->interferences.size();
+            auto& n = _nodes[idx];
 
-            if (it_degree > degree
-                && it_degree < k
-                && it->moves.empty())
+            if (n.state != NS_SPILL) { continue; }
+
+            _spill_worklist[kept++] = idx;
+
+            auto cost = n.no_spill
+                ? std::numeric_limits<float>::infinity()
+                : n.spill_cost / std::max(n.degree, 1);
+
+            if (!selected.has_value() || cost < best)
             {
-                selected = it;
-                degree = it_degree;
+                selected = idx;
+                best = cost;
             }
-
-            ++it;
         }
-        
-        if (selected == nodes.end())
+
+        _spill_worklist.resize(kept);
+
+        if (!selected.has_value())
         {
-            return std::nullopt;
+            return false;
         }
-        else
-        {
-            it = nodes.begin();
 
-            while (it != nodes.end())
-            {
-                if (it != selected)
-                {
-                    for (auto key: selected->keys)
-                    {
-                        it->interferences.erase(key);
-                    }
-                }
+        _set_state(*selected, NS_SIMPLIFY);
+        _freeze_moves(*selected);
+        return true;
+    }
 
-                ++it;
-            }
+    std::vector<MachineInstruction*> InterferenceGraph::coalesced_moves()
+    {
+        std::vector<MachineInstruction*> res;
 
-            auto opt = std::optional<IGNode>{*selected};
-            nodes.erase(selected);
-            return opt;
+        for (auto& move: _moves)
+        {
+            if (move.state == MS_COALESCED)
+            {
+                res.push_back(move.inst);
+            }
         }
-    }
 
-    std::optional<IGNode> InterferenceGraph::pop_highest_degree()
-    {
-        return pop_node(10000);
+        return res;
     }
 
-    void InterferenceGraph::push_node(IGNode node)
+    InterferenceGraph build_interference_graph(
+        Procedure& proc,
+        const std::vector<TypeID>& tys,
+        const std::set<RegisterID>& no_spill,
+        std::shared_ptr<Target> target)
     {
-        nodes.push_back(node);
+        InterferenceGraph res;
+        std::vector<float> ref_weights;
+        std::vector<int> live_spans;
+        // nodes live below the current instruction
+        std::vector<std::uint32_t> live;
+        std::vector<bool> is_live;
 
-        for (auto reg: node.interferences)
+        auto get = [&](RegisterID reg)
         {
-            auto it = std::find_if(nodes.begin(), nodes.end(), [&](auto& n){ return n.keys.contains(reg); });
+            auto idx = res.get(reg);
 
-            if (it == nodes.end())
+            if (idx >= ref_weights.size())
             {
-                std::cerr << "interference missing" << std::endl;
-                abort();
+                ref_weights.resize(idx + 1, 0);
+                live_spans.resize(idx + 1, 0);
+                is_live.resize(idx + 1, false);
             }
 
-            for (auto key: node.keys)
+            return idx;
+        };
+
+        auto make_live = [&](std::uint32_t idx)
+        {
+            if (!is_live[idx])
             {
-                it->interferences.insert(key);
+                is_live[idx] = true;
+                live.push_back(idx);
             }
-        }
-    }
-
-    InterferenceGraph build_interference_graph(Procedure& proc, const std::vector<TypeID>& tys, std::shared_ptr<Target> target)
-    {
-        InterferenceGraph res;
+        };
 
-        //std::cout << "building interference graph:" << std::endl;
+        auto kill = [&](std::uint32_t idx)
+        {
+            if (is_live[idx])
+            {
+                is_live[idx] = false;
+                live.erase(std::find(live.begin(), live.end(), idx));
+            }
+        };
 
         for (auto& bblock: proc.bblocks())
         {
-            //std::cout << "bblock" << std::endl;
-            std::set<RegisterID> live_regs;
+            for (auto idx: live)
+            {
+                is_live[idx] = false;
+            }
+
+            live.clear();
 
-            //std::cout << "adding live outs" << std::endl;
             for (auto pair: bblock.live_outs())
             {
                 auto it = std::find_if(
@@ -435,42 +544,45 @@ namespace ucb
 
                 if (it != tys.end())
                 {
-                    //std::cout << "added reg " << pair.first.val << " from live outs" << std::endl;
-                    live_regs.insert(pair.first);
+                    make_live(get(pair.first));
                 }
             }
 
             auto& insts = bblock.machine_insts();
+            // references in hot blocks make a node expensive to spill
+            auto weight = bblock.frequency();
 
-            //std::cout << "instructions:" << std::endl;
             for (auto it = insts.rbegin(); it != insts.rend(); it++)
             {
-                //std::cout << "inst" << std::endl;
                 // add/remove live regs
                 for (auto& opnd: it->opnds)
                 {
-                    //std::cout << "opnd is def = " << opnd.is_def << " & is use = " << opnd.is_use << std::endl;
+                    if (opnd.kind != MachineOperand::Register) { continue; }
+
+                    auto idx = get(std::bit_cast<RegisterID>(opnd.val));
+
                     if (opnd.is_def && !opnd.is_use)
                     {
-                        // remove def from live regs
-                        auto reg = std::bit_cast<RegisterID>(opnd.val);
-                        live_regs.erase(reg);
-                        //std::cout << "remove live reg " << reg.val << std::endl;
-                        //std::cout << "live regs:";
-                        //for (auto lr: live_regs) { std::cout << " " << lr.val; }
-                        //std::cout << std::endl;
+                        // a def clobbers whatever is live past it, even
+                        // when nothing reads it afterwards
+                        kill(idx);
+
+                        for (auto b: live)
+                        {
+                            res.add_interference(idx, b);
+                        }
                     }
-                    else if (opnd.kind == MachineOperand::Register)
+                    else
                     {
-                        // add use to live regs
-                        auto reg = std::bit_cast<RegisterID>(opnd.val);
-                        live_regs.insert(reg);
-                        //std::cout << "add live reg " << reg.val << std::endl;
-                        //std::cout << "live regs:";
-                        //for (auto lr: live_regs) { std::cout << " " << lr.val; }
-                        //std::cout << std::endl;
-                        res.get(reg); // single get to make sure its on the graph
+                        make_live(idx);
                     }
+
+                    ref_weights[idx] += weight;
+                }
+
+                for (auto idx: live)
+                {
+                    ++live_spans[idx];
                 }
 
                 // add interferences
@@ -478,41 +590,102 @@ namespace ucb
                 {
                     if (!opnd.is_def && opnd.kind == MachineOperand::Register)
                     {
-                        auto a = std::bit_cast<RegisterID>(opnd.val);
+                        auto a = get(std::bit_cast<RegisterID>(opnd.val));
 
-                        for (auto b: live_regs)
+                        for (auto b: live)
                         {
                             res.add_interference(a, b);
                         }
                     }
                 }
 
-                // add moves
-                if (target->is_rr_move(it->opc))
+                // add moves, isel may fold a load into the source operand
+                auto is_rr = std::all_of(it->opnds.begin(), it->opnds.end(), [](auto& opnd)
                 {
-                    auto move_inst = &(*it);
+                    return opnd.kind == MachineOperand::Register;
+                });
 
-                    for (auto& opnd: it->opnds)
+                if (target->is_rr_move(it->opc) && is_rr && it->opnds.size() == 2)
+                {
+                    auto a = get(std::bit_cast<RegisterID>(it->opnds[0].val));
+                    auto b = get(std::bit_cast<RegisterID>(it->opnds[1].val));
+
+                    if (a != b)
                     {
-                        if (opnd.kind == MachineOperand::Register)
-                        {
-                            auto key = std::bit_cast<RegisterID>(opnd.val);
-                            auto& node = res.get(key);
-                            node.moves.insert(move_inst);
-                        }
+                        res.add_move(&(*it), a, b);
                     }
                 }
             }
         }
 
+        for (std::uint32_t idx = 0; idx < res.size(); ++idx)
+        {
+            auto& node = res.node(idx);
+            node.spill_cost = ref_weights[idx] / std::max(live_spans[idx], 1);
+            node.no_spill = node.physical_register != NO_REG || no_spill.contains(node.reg);
+        }
+
         return res;
     }
 
     void InterferenceGraph::dump()
     {
-        for (auto& node: nodes)
+        // group the keys by representative in one pass
+        std::vector<std::vector<RegisterID>> keys(_nodes.size());
+
+        for (std::uint32_t i = 0; i < _nodes.size(); ++i)
+        {
+            keys[find(i)].push_back(_nodes[i].reg);
+        }
+
+        for (std::uint32_t idx = 0; idx < _nodes.size(); ++idx)
         {
-            node.dump();
+            if (find(idx) != idx) { continue; }
+
+            auto& node = _nodes[idx];
+            std::cout << "\tkeys: { ";
+            std::string junc = "";
+
+            for (auto reg: keys[idx])
+            {
+                std::cout << junc << reg.val;
+                junc = ", ";
+            }
+
+            std::cout << " }, interferences: { ";
+            junc = "";
+            auto mark = _next_mark();
+
+            for (auto i: node.adj)
+            {
+                auto n = find(i);
+
+                if (_marks[n] != mark)
+                {
+                    _marks[n] = mark;
+                    std::cout << junc << _nodes[n].reg.val;
+                    junc = ", ";
+                }
+            }
+
+            std::cout << " }, moves: ";
+            junc = "";
+
+            for (auto mv: node.moves)
+            {
+                if (_moves[mv].state == MS_WORKLIST || _moves[mv].state == MS_ACTIVE)
+                {
+                    std::cout << junc << _moves[mv].inst;
+                    junc = ", ";
+                }
+            }
+
+            if (node.physical_register != NO_REG)
+            {
+                std::cout << ", physical reg: " << node.physical_register.val;
+            }
+
+            std::cout << std::endl;
         }
 
         std::cout << std::endl;
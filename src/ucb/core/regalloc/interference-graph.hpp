@@ -1,7 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <set>
-#include <optional>
+#include <vector>
 
 #include <ucb/core/target.hpp>
 #include <ucb/core/ir/procedure.hpp>
@@ -10,48 +11,145 @@
 
 namespace ucb
 {
+    // the list a node is on while the graph is simplified, see Appel's
+    // iterated register coalescing
+    enum NodeState
+    {
+        NS_PRECOLORED,
+        NS_INITIAL,
+        NS_SIMPLIFY,
+        NS_FREEZE,
+        NS_SPILL,
+        NS_COALESCED,
+        NS_SELECT
+    };
+
+    enum MoveState
+    {
+        MS_WORKLIST,
+        MS_ACTIVE,
+        MS_COALESCED,
+        MS_CONSTRAINED,
+        MS_FROZEN
+    };
+
     struct IGNode
     {
-        std::set<RegisterID> keys;
-        std::set<RegisterID> interferences;
-        std::set<MachineInstruction*> moves;
+        RegisterID reg;
+        // the node this one was coalesced into, itself while it is a
+        // node of its own
+        std::uint32_t alias;
+
+        // entries may name nodes that were coalesced since, see find.
+        // precolored nodes keep no neighbors, nothing is ever removed from
+        // them
+        std::vector<std::uint32_t> adj;
+        // indices into the graph's moves
+        std::vector<std::uint32_t> moves;
 
         RegisterID physical_register{NO_REG};
+        // neighbors that are neither coalesced nor on the select stack,
+        // precolored nodes count as having infinite degree
+        int degree{0};
 
+        NodeState state{NS_INITIAL};
         bool no_spill{false};
-
-        bool interferes_with(const IGNode& other);
-
-        void dump();
+        // uses weighted by loop depth over the instructions the node is
+        // live across, the cheapest node per degree is spilled first
+        float spill_cost{0};
     };
 
-    struct InterferenceGraph
+    struct IGMove
     {
-        std::vector<IGNode> nodes;
-
-        bool is_interference(RegisterID a, RegisterID b);
-        void add_interference(RegisterID a, RegisterID b);
-
-        IGNode& get(RegisterID key);
-        int get_neighbor_count(IGNode& node, int k);
-
-        bool briggs(IGNode& a, IGNode& b, int k);
-
-        bool empty();
-        bool can_simplify();
-        // bool can_coalesce();
+        MachineInstruction *inst;
+        std::uint32_t a;
+        std::uint32_t b;
+        MoveState state{MS_WORKLIST};
+    };
 
-        std::pair<bool, std::set<MachineInstruction*>> coalesce(int k);
-        bool freeze_move();
-        std::optional<IGNode> pop_node(int k);
-        std::optional<IGNode> pop_highest_degree();
-        void push_node(IGNode node);
+    // nodes are indexed densely in the order their registers show up.
+    // membership is a lower triangular bit matrix over those indices and
+    // the adjacency vectors are only used to walk the neighbors. coalescing
+    // links a node to the other one instead of merging their keys.
+    //
+    // once make_worklists is called every node sits on exactly one
+    // worklist, the lists are vectors whose stale entries are skipped when
+    // popped, so each step only touches the nodes it changes
+    class InterferenceGraph
+    {
+    public:
+        // node of key, created on first use
+        std::uint32_t get(RegisterID key);
+        // representative of a node, after following coalesced aliases
+        std::uint32_t find(std::uint32_t idx);
+        // representative node of a register already on the graph
+        IGNode& node_of(RegisterID key);
+        IGNode& node(std::uint32_t idx) { return _nodes[idx]; }
+        std::uint32_t size() const { return _nodes.size(); }
+
+        bool is_interference(std::uint32_t a, std::uint32_t b) const;
+        void add_interference(std::uint32_t a, std::uint32_t b);
+        void add_move(MachineInstruction *inst, std::uint32_t a, std::uint32_t b);
+
+        bool is_move_related(std::uint32_t idx);
+        bool briggs(std::uint32_t a, std::uint32_t b);
+        // a precolored node a can take b if every neighbor of b is
+        // insignificant or already next to a
+        bool george(std::uint32_t a, std::uint32_t b);
+
+        // k is the number of colors
+        void make_worklists(int k);
+
+        // each step returns false when its worklist is empty
+        bool simplify();
+        bool coalesce();
+        bool freeze();
+        bool select_spill();
+
+        // nodes in the order simplify removed them
+        std::vector<std::uint32_t>& select_stack() { return _select_stack; }
+        // moves made redundant by coalescing
+        std::vector<MachineInstruction*> coalesced_moves();
 
         void dump();
 
-        // void merge(RegisterID a, RegisterID b);
-        // void clean_dead_nodes();
+    private:
+        std::vector<IGNode> _nodes;
+        std::vector<IGMove> _moves;
+        // node index by register number, -1 when not on the graph
+        std::vector<std::int32_t> _node_idxs;
+        // bit (a, b) with a > b is at a * (a - 1) / 2 + b
+        std::vector<std::uint64_t> _matrix;
+        int _k{0};
+
+        std::vector<std::uint32_t> _simplify_worklist;
+        std::vector<std::uint32_t> _freeze_worklist;
+        std::vector<std::uint32_t> _spill_worklist;
+        std::vector<std::uint32_t> _move_worklist;
+        std::vector<std::uint32_t> _select_stack;
+
+        // scratch marks to count each representative once
+        std::vector<std::uint32_t> _marks;
+        std::uint32_t _mark{0};
+
+        static std::uint64_t _bit(std::uint32_t a, std::uint32_t b);
+        std::uint32_t _next_mark();
+
+        bool _is_significant(std::uint32_t idx) const;
+        bool _is_adjacent(std::uint32_t idx) const;
+        void _set_state(std::uint32_t idx, NodeState state);
+        void _decrement_degree(std::uint32_t idx);
+        void _enable_moves(std::uint32_t idx);
+        void _add_worklist(std::uint32_t idx);
+        void _combine(std::uint32_t a, std::uint32_t b);
+        void _freeze_moves(std::uint32_t idx);
     };
 
-    InterferenceGraph build_interference_graph(Procedure& proc, const std::vector<TypeID>& tys, std::shared_ptr<Target> target);
+    // registers in no_spill are spill temporaries, they are never picked as
+    // spill candidates again
+    InterferenceGraph build_interference_graph(
+        Procedure& proc,
+        const std::vector<TypeID>& tys,
+        const std::set<RegisterID>& no_spill,
+        std::shared_ptr<Target> target);
 }
@@ -0,0 +1,344 @@
+#include <ucb/core/regalloc/linear-scan.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+#include <ucb/core/regalloc/spill.hpp>
+
+namespace ucb
+{
+    bool LiveIntervals::fixed_conflict(RegisterID reg, std::uint32_t start, std::uint32_t end) const
+    {
+        auto it = fixed.find(reg.val);
+
+        if (it == fixed.end())
+        {
+            return false;
+        }
+
+        // ranges are disjoint, so their ends are sorted as well
+        auto& ranges = it->second;
+        auto range = std::lower_bound(
+            ranges.begin(),
+            ranges.end(),
+            start,
+            [](auto& r, auto pos){ return r.end < pos; });
+
+        return range != ranges.end() && range->start <= end;
+    }
+
+    LiveIntervals build_live_intervals(Procedure& proc, const std::set<RegisterID>& no_spill)
+    {
+        LiveIntervals res;
+        std::unordered_map<std::uint64_t, std::size_t> vreg_idxs;
+        // type each register was last seen with, set before its range is added
+        std::unordered_map<std::uint64_t, TypeID> reg_tys;
+        std::uint32_t idx = 0;
+
+        auto add_range = [&](RegisterID reg, std::uint32_t start, std::uint32_t end)
+        {
+            if (is_physical_reg(reg))
+            {
+                res.fixed[reg.val].push_back({ start, end });
+                return;
+            }
+
+            auto [it, inserted] = vreg_idxs.try_emplace(reg.val, res.vregs.size());
+
+            if (inserted)
+            {
+                res.vregs.push_back({
+                    .reg = reg,
+                    .ty = reg_tys.at(reg.val),
+                    .start = start,
+                    .end = end,
+                    .no_spill = no_spill.contains(reg)
+                });
+            }
+            else
+            {
+                auto& interval = res.vregs[it->second];
+                interval.start = std::min(interval.start, start);
+                interval.end = std::max(interval.end, end);
+            }
+        };
+
+        for (auto& bblock: proc.bblocks())
+        {
+            auto& insts = bblock.machine_insts();
+            auto block_start = 2 * idx;
+            idx += insts.size();
+            auto pos = idx;
+
+            // registers live below the current instruction and where their
+            // range ends, the block is walked backwards
+            std::unordered_map<std::uint64_t, std::pair<RegisterID, std::uint32_t>> open;
+
+            for (auto [reg, ty]: bblock.live_outs())
+            {
+                reg_tys[reg.val] = ty;
+                open.try_emplace(reg.val, reg, 2 * idx);
+            }
+
+            for (auto it = insts.rbegin(); it != insts.rend(); ++it)
+            {
+                --pos;
+
+                for (auto& opnd: it->opnds)
+                {
+                    if (opnd.kind != MachineOperand::Register || !opnd.is_def) { continue; }
+
+                    auto reg = std::bit_cast<RegisterID>(opnd.val);
+                    auto live = open.find(reg.val);
+                    reg_tys[reg.val] = opnd.ty;
+
+                    if (live == open.end())
+                    {
+                        // never read, it still clobbers the register
+                        add_range(reg, 2 * pos + 1, 2 * pos + 1);
+                    }
+                    else
+                    {
+                        add_range(live->second.first, 2 * pos + 1, live->second.second);
+                        open.erase(live);
+                    }
+                }
+
+                for (auto& opnd: it->opnds)
+                {
+                    if (opnd.kind != MachineOperand::Register || (opnd.is_def && !opnd.is_use)) { continue; }
+
+                    auto reg = std::bit_cast<RegisterID>(opnd.val);
+                    reg_tys[reg.val] = opnd.ty;
+                    open.try_emplace(reg.val, reg, 2 * pos);
+                }
+            }
+
+            for (auto& [val, live]: open)
+            {
+                add_range(live.first, block_start, live.second);
+            }
+        }
+
+        for (auto& [val, ranges]: res.fixed)
+        {
+            std::sort(ranges.begin(), ranges.end(), [](auto& a, auto& b){ return a.start < b.start; });
+        }
+
+        std::sort(res.vregs.begin(), res.vregs.end(), [](auto& a, auto& b)
+        {
+            return a.start != b.start ? a.start < b.start : a.reg.val < b.reg.val;
+        });
+
+        return res;
+    }
+
+    void LinearScanRegAlloc::run_on_procedure(std::shared_ptr<Procedure> proc, bool debug)
+    {
+        auto& reg_classes = _target->load_reg_classes();
+        // spill temporaries, they only live around a single instruction
+        std::set<RegisterID> no_spill;
+        std::unordered_map<std::uint64_t, RegisterID> assigned;
+
+        if (debug)
+        {
+            std::cout << "register allocation for procedure: " << proc->name() << "\n\n";
+        }
+
+        for (auto& reg_class: reg_classes)
+        {
+            while (true)
+            {
+                auto intervals = build_live_intervals(*proc, no_spill);
+
+                // registers taken by an earlier class are left alone
+                for (auto& interval: intervals.vregs)
+                {
+                    auto it = assigned.find(interval.reg.val);
+
+                    if (it != assigned.end())
+                    {
+                        interval.physical_register = it->second;
+                    }
+                }
+
+                auto spills = scan(intervals, reg_class);
+
+                if (debug)
+                {
+                    std::cout << "live intervals:\n";
+
+                    for (auto& interval: intervals.vregs)
+                    {
+                        std::cout << "\t" << interval.reg.val << " [" << interval.start << ", " << interval.end << "]";
+
+                        if (interval.physical_register != NO_REG)
+                        {
+                            std::cout << ", physical reg: " << interval.physical_register.val;
+                        }
+
+                        std::cout << "\n";
+                    }
+
+                    std::cout << "spills: " << spills.size() << "\n\n";
+                }
+
+                if (spills.empty())
+                {
+                    for (auto& interval: intervals.vregs)
+                    {
+                        if (interval.physical_register != NO_REG)
+                        {
+                            assigned.try_emplace(interval.reg.val, interval.physical_register);
+                        }
+                    }
+
+                    break;
+                }
+
+                insert_spill_code(*proc, *_target, spills, no_spill);
+                proc->compute_machine_lifetimes();
+            }
+        }
+
+        select_registers(*proc, assigned);
+
+        if (debug)
+        {
+            std::cout << "procedure " << proc->name() << " after register allocation\n\n";
+
+            for (auto& bblock: proc->bblocks())
+            {
+                _target->dump_bblock(bblock, std::cout);
+            }
+        }
+    }
+
+    std::set<RegisterID> LinearScanRegAlloc::scan(LiveIntervals& intervals, const RegisterClass& reg_class)
+    {
+        std::set<RegisterID> spills;
+        // intervals holding a register, sorted by end
+        std::vector<LiveInterval*> active;
+
+        auto activate = [&](LiveInterval *interval)
+        {
+            auto pos = std::upper_bound(
+                active.begin(),
+                active.end(),
+                interval->end,
+                [](auto end, auto a){ return end < a->end; });
+
+            active.insert(pos, interval);
+        };
+
+        auto in_class = [&](TypeID ty)
+        {
+            return std::any_of(reg_class.tys.begin(), reg_class.tys.end(), [&](auto t){ return t.val == ty.val; });
+        };
+
+        for (auto& cur: intervals.vregs)
+        {
+            // other classes allocate the rest
+            if (cur.physical_register != NO_REG || !in_class(cur.ty)) { continue; }
+
+            // expire everything that ended before cur starts
+            auto expired = std::find_if(active.begin(), active.end(), [&](auto a){ return a->end >= cur.start; });
+            active.erase(active.begin(), expired);
+
+            auto is_free = [&](RegisterID reg)
+            {
+                for (auto a: active)
+                {
+                    if (a->physical_register.val == reg.val) { return false; }
+                }
+
+                return !intervals.fixed_conflict(reg, cur.start, cur.end);
+            };
+
+            auto reg = std::find_if(reg_class.physical_regs.begin(), reg_class.physical_regs.end(), is_free);
+
+            if (reg != reg_class.physical_regs.end())
+            {
+                cur.physical_register = { reg->val, cur.reg.size };
+                activate(&cur);
+                continue;
+            }
+
+            // out of registers, spill whichever interval ends last
+            auto victim = std::find_if(active.rbegin(), active.rend(), [&](auto a)
+            {
+                return !a->no_spill && !intervals.fixed_conflict(a->physical_register, cur.start, cur.end);
+            });
+
+            if (victim != active.rend() && (cur.no_spill || (*victim)->end > cur.end))
+            {
+                auto v = *victim;
+                cur.physical_register = { v->physical_register.val, cur.reg.size };
+                v->physical_register = NO_REG;
+                spills.insert(v->reg);
+
+                active.erase(std::find(active.begin(), active.end(), v));
+                activate(&cur);
+            }
+            else if (cur.no_spill)
+            {
+                std::cerr << "no register left for a spill temporary" << std::endl;
+                abort();
+            }
+            else
+            {
+                spills.insert(cur.reg);
+            }
+        }
+
+        return spills;
+    }
+
+    void LinearScanRegAlloc::select_registers(Procedure& proc, const std::unordered_map<std::uint64_t, RegisterID>& assigned)
+    {
+        for (auto& bblock: proc.bblocks())
+        {
+            auto& insts = bblock.machine_insts();
+            auto it = insts.begin();
+
+            while (it != insts.end())
+            {
+                for (auto& opnd: it->opnds)
+                {
+                    if (opnd.kind != MachineOperand::Register) { continue; }
+
+                    auto reg = std::bit_cast<RegisterID>(opnd.val);
+
+                    if (is_physical_reg(reg)) { continue; }
+
+                    auto p = assigned.find(reg.val);
+
+                    if (p == assigned.end())
+                    {
+                        std::cerr << "register " << reg.val << " was not allocated" << std::endl;
+                        abort();
+                    }
+
+                    RegisterID phys_reg = { p->second.val, reg.size };
+                    opnd.val = std::bit_cast<std::uint64_t>(phys_reg);
+                }
+
+                // moves whose ends landed in the same register do nothing
+                auto is_noop = _target->is_rr_move(it->opc)
+                    && it->opnds.size() == 2
+                    && it->opnds[0].kind == MachineOperand::Register
+                    && it->opnds[1].kind == MachineOperand::Register
+                    && it->opnds[0].val == it->opnds[1].val;
+
+                if (is_noop)
+                {
+                    it = insts.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+}
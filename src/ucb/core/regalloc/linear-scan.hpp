@@ -0,0 +1,64 @@
+#pragma once
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <ucb/core/target.hpp>
+#include <ucb/core/regalloc/regalloc.hpp>
+
+namespace ucb
+{
+    // instructions are numbered in block order, instruction i reads its
+    // operands at 2 * i and writes its defs at 2 * i + 1
+    struct LiveRange
+    {
+        std::uint32_t start;
+        std::uint32_t end;
+    };
+
+    // a virtual register is allocated over the hull of its ranges
+    struct LiveInterval
+    {
+        RegisterID reg;
+        // machine type, picks the register class
+        TypeID ty{T_NONE};
+        std::uint32_t start;
+        std::uint32_t end;
+
+        RegisterID physical_register{NO_REG};
+
+        bool no_spill{false};
+    };
+
+    struct LiveIntervals
+    {
+        std::vector<LiveInterval> vregs;
+        // physical registers keep their exact ranges, sorted and disjoint
+        std::unordered_map<std::uint64_t, std::vector<LiveRange>> fixed;
+
+        bool fixed_conflict(RegisterID reg, std::uint32_t start, std::uint32_t end) const;
+    };
+
+    LiveIntervals build_live_intervals(Procedure& proc, const std::set<RegisterID>& no_spill);
+
+    // allocates a whole procedure in one sweep over its intervals sorted by
+    // start. when the registers run out the interval ending last is spilled,
+    // trading some code quality for time close to linear in the procedure
+    class LinearScanRegAlloc : public RegAlloc
+    {
+    public:
+        LinearScanRegAlloc(std::shared_ptr<Target> target):
+            _target(std::move(target))
+        {
+        }
+
+        void run_on_procedure(std::shared_ptr<Procedure> proc, bool debug) override;
+
+    private:
+        std::shared_ptr<Target> _target;
+
+        std::set<RegisterID> scan(LiveIntervals& intervals, const RegisterClass& reg_class);
+        void select_registers(Procedure& proc, const std::unordered_map<std::uint64_t, RegisterID>& assigned);
+    };
+}
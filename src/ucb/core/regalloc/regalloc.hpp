@@ -7,6 +7,7 @@ namespace ucb
     class RegAlloc
     {
     public:
+        // may run concurrently for different procedures of the same unit
         virtual void run_on_procedure(std::shared_ptr<Procedure> proc, bool debug) = 0;
 
         virtual ~RegAlloc() = default;
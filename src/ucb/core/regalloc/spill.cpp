@@ -0,0 +1,99 @@
+#include <ucb/core/regalloc/spill.hpp>
+
+#include <algorithm>
+#include <map>
+
+namespace ucb
+{
+    void insert_spill_code(Procedure& proc, Target& target, const std::set<RegisterID>& spills, std::set<RegisterID>& no_spill)
+    {
+        // every spilled register gets its own frame slot, laid out by
+        // stack_lower with the rest of the frame
+        auto& symbols = proc.context()->symbols();
+        std::map<std::uint64_t, std::uint64_t> slots;
+        std::map<std::uint64_t, int> temp_counts;
+        std::set<std::uint64_t> spilled;
+
+        for (auto reg: spills)
+        {
+            spilled.insert(reg.val);
+        }
+
+        for (auto& bblock: proc.bblocks())
+        {
+            auto& insts = bblock.machine_insts();
+            auto it = insts.begin();
+
+            while (it != insts.end())
+            {
+                struct Temp
+                {
+                    RegisterID reg;
+                    TypeID ty;
+                    std::uint64_t slot;
+                    bool is_used;
+                    bool is_defined;
+                };
+
+                // one short lived temporary per spilled register and
+                // instruction, loaded before its uses and stored after its defs
+                std::vector<Temp> temps;
+
+                for (auto& opnd: it->opnds)
+                {
+                    if (opnd.kind != MachineOperand::Register) { continue; }
+
+                    auto reg = std::bit_cast<RegisterID>(opnd.val);
+
+                    if (!spilled.contains(reg.val)) { continue; }
+
+                    auto slot = slots.find(reg.val);
+
+                    if (slot == slots.end())
+                    {
+                        auto idx = proc.frame().size();
+                        proc.add_frame_slot(symbols.intern("$spill." + std::to_string(idx)), opnd.ty);
+                        slot = slots.emplace(std::uint64_t{reg.val}, idx).first;
+                    }
+
+                    auto temp = std::find_if(temps.begin(), temps.end(), [&](auto& t)
+                    {
+                        return t.slot == slot->second;
+                    });
+
+                    if (temp == temps.end())
+                    {
+                        auto id = "$spill." + std::to_string(slot->second) + "." + std::to_string(temp_counts[slot->second]++);
+                        auto temp_reg = proc.add_vreg(symbols.intern(id), opnd.ty);
+                        temp_reg.size = reg.size;
+                        no_spill.insert(temp_reg);
+                        temps.push_back({ temp_reg, opnd.ty, slot->second, false, false });
+                        temp = temps.end() - 1;
+                    }
+
+                    temp->is_used = temp->is_used || !opnd.is_def || opnd.is_use;
+                    temp->is_defined = temp->is_defined || opnd.is_def;
+                    opnd.val = std::bit_cast<std::uint64_t>(temp->reg);
+                }
+
+                auto next = it;
+                ++next;
+
+                for (auto& temp: temps)
+                {
+                    if (temp.is_used)
+                    {
+                        insts.insert(it, target.load_from_slot(temp.reg, temp.ty, temp.slot));
+                    }
+
+                    if (temp.is_defined)
+                    {
+                        insts.insert(next, target.store_to_slot(temp.reg, temp.ty, temp.slot));
+                    }
+                }
+
+                it = next;
+            }
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <set>
+
+#include <ucb/core/target.hpp>
+#include <ucb/core/ir/procedure.hpp>
+
+namespace ucb
+{
+    // moves every register in spills to a new frame slot. each instruction
+    // touching one gets a fresh temporary instead, loaded before its uses
+    // and stored after its defs. the temporaries are added to no_spill, the
+    // machine lifetimes must be recomputed afterwards
+    void insert_spill_code(Procedure& proc, Target& target, const std::set<RegisterID>& spills, std::set<RegisterID>& no_spill);
+}
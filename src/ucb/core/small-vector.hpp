@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include <ucb/core/arena.hpp>
+
+namespace ucb
+{
+    // vector that keeps up to N elements inline and spills to an arena when
+    // it grows past that, only meant for small trivially copyable values
+    template<typename T, std::size_t N>
+    class SmallVector
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SmallVector only holds trivially copyable types");
+
+    public:
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        explicit SmallVector(Arena *arena):
+            _arena{arena}
+        {
+            assert(_arena);
+        }
+
+        SmallVector(const SmallVector& other):
+            _arena{other._arena}
+        {
+            _copy_from(other);
+        }
+
+        SmallVector& operator = (const SmallVector& other)
+        {
+            if (this != &other)
+            {
+                _size = 0;
+                _copy_from(other);
+            }
+
+            return *this;
+        }
+
+        T* begin() { return _data; }
+        T* end() { return _data + _size; }
+        const T* begin() const { return _data; }
+        const T* end() const { return _data + _size; }
+
+        T& operator [] (std::size_t idx) { assert(idx < _size); return _data[idx]; }
+        const T& operator [] (std::size_t idx) const { assert(idx < _size); return _data[idx]; }
+
+        T& front() { assert(_size); return _data[0]; }
+        T& back() { assert(_size); return _data[_size - 1]; }
+
+        std::size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+        bool is_inline() const { return _data == _inline; }
+
+        void push_back(const T& val)
+        {
+            if (_size == _capacity)
+            {
+                _grow(_capacity * 2);
+            }
+
+            _data[_size++] = val;
+        }
+
+        T* erase(T *pos)
+        {
+            assert(pos >= begin() && pos < end());
+            std::memmove(pos, pos + 1, (end() - pos - 1) * sizeof(T));
+            --_size;
+            return pos;
+        }
+
+        void clear()
+        {
+            _size = 0;
+        }
+
+    private:
+        T _inline[N];
+        T *_data{_inline};
+        std::size_t _size{0};
+        std::size_t _capacity{N};
+        Arena *_arena;
+
+        void _grow(std::size_t capacity)
+        {
+            auto data = static_cast<T*>(_arena->allocate(capacity * sizeof(T), alignof(T)));
+            std::memcpy(data, _data, _size * sizeof(T));
+            _data = data;
+            _capacity = capacity;
+        }
+
+        void _copy_from(const SmallVector& other)
+        {
+            if (other._size > _capacity)
+            {
+                _grow(other._size);
+            }
+
+            std::memcpy(_data, other._data, other._size * sizeof(T));
+            _size = other._size;
+        }
+    };
+}
@@ -4,16 +4,43 @@ namespace ucb
 {
     void TargetMachine::compile(std::shared_ptr<CompileUnit> unit, const std::string& src_file, std::ostream& output)
     {
-        for(auto& proc: unit->procs())
-        {
-            proc->dump(std::cout);
+        auto& procs = unit->procs();
 
-            _isel->run_on_procedure(proc, true);
-            _regalloc->run_on_procedure(proc, true);
-            _target->stack_lower(*proc);
-            //_target->dump_proc(*proc, std::cout);
+        if (_pool != nullptr && _pool->size() > 1)
+        {
+            // debug dumps would interleave, so workers run quietly
+            _pool->parallel_for(procs.size(), [&](std::size_t i)
+            {
+                compile_procedure(procs[i], false);
+            });
+        }
+        else
+        {
+            for(auto& proc: procs)
+            {
+                proc->dump(std::cout);
+                compile_procedure(proc, true);
+            }
         }
 
         _target->print_asm(*unit, output, src_file);
     }
+
+    void TargetMachine::compile_procedure(std::shared_ptr<Procedure> proc, bool debug)
+    {
+        _isel->run_on_procedure(proc, debug);
+        _regalloc->run_on_procedure(proc, debug);
+        _target->stack_lower(*proc);
+        //_target->dump_proc(*proc, std::cout);
+    }
+
+    void TargetMachine::begin_asm(const std::string& src_file, std::ostream& output)
+    {
+        _target->begin_asm(output, src_file);
+    }
+
+    void TargetMachine::emit(Procedure& proc, std::ostream& output)
+    {
+        _target->print_proc_asm(proc, output);
+    }
 }
@@ -3,6 +3,7 @@
 #include <ostream>
 
 #include <ucb/core/target.hpp>
+#include <ucb/core/thread-pool.hpp>
 #include <ucb/core/ir/compile-unit.hpp>
 #include <ucb/core/isel/isel.hpp>
 #include <ucb/core/regalloc/regalloc.hpp>
@@ -17,20 +18,35 @@ namespace ucb
     class TargetMachine
     {
     public:
-        TargetMachine(TargetArch arch, std::unique_ptr<ISel> isel, std::unique_ptr<RegAlloc> regalloc, std::shared_ptr<Target> target):
+        // with a pool the procedures are selected and allocated concurrently,
+        // the assembly is still printed in declaration order
+        TargetMachine(
+                TargetArch arch,
+                std::unique_ptr<ISel> isel,
+                std::unique_ptr<RegAlloc> regalloc,
+                std::shared_ptr<Target> target,
+                std::shared_ptr<ThreadPool> pool = nullptr):
             _arch{arch},
             _isel(std::move(isel)),
             _regalloc(std::move(regalloc)),
-            _target(std::move(target))
+            _target(std::move(target)),
+            _pool(std::move(pool))
         {
         }
 
         void compile(std::shared_ptr<CompileUnit> unit, const std::string& src_file, std::ostream& output);
 
+        // pieces of compile for callers that go one procedure at a time,
+        // procedures have to be emitted in the order they are printed in
+        void begin_asm(const std::string& src_file, std::ostream& output);
+        void compile_procedure(std::shared_ptr<Procedure> proc, bool debug);
+        void emit(Procedure& proc, std::ostream& output);
+
     private:
         TargetArch _arch;
         std::unique_ptr<ISel> _isel;
         std::unique_ptr<RegAlloc> _regalloc;
         std::shared_ptr<Target> _target;
+        std::shared_ptr<ThreadPool> _pool;
     };
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <vector>
 
 #include <ucb/core/ir/procedure.hpp>
@@ -18,16 +19,24 @@ namespace ucb
     public:
         virtual ~Target() = default;
 
-        virtual std::vector<Pat> load_pats() = 0;
-        virtual std::vector<RegisterClass> load_reg_classes() = 0;
+        // may be called from several codegen workers at once
+        virtual std::span<const Pat> load_pats() = 0;
+        virtual const std::vector<RegisterClass>& load_reg_classes() = 0;
 
         virtual bool is_rr_move(MachineOpc opc) = 0;
+        // spill code, slot is an index into the procedure's frame
+        virtual MachineInstruction load_from_slot(RegisterID reg, TypeID ty, std::uint64_t slot) = 0;
+        virtual MachineInstruction store_to_slot(RegisterID reg, TypeID ty, std::uint64_t slot) = 0;
 
         virtual void dump_proc(Procedure& proc, std::ostream& out) = 0;
         virtual void dump_bblock(BasicBlock& bblock, std::ostream& out) = 0;
         virtual void abi_lower(Procedure& proc) = 0;
         virtual void stack_lower(Procedure& proc) = 0;
 
+        // a file is begin_asm and then print_proc_asm for each procedure in
+        // order, print_asm does it for a whole unit
+        virtual void begin_asm(std::ostream& out, const std::string& src_filename) = 0;
+        virtual void print_proc_asm(Procedure& proc, std::ostream& out) = 0;
         virtual void print_asm(CompileUnit& unit, std::ostream& out, const std::string& src_filename) = 0;
     };
 }
@@ -0,0 +1,152 @@
+#include <ucb/core/thread-pool.hpp>
+
+#include <cassert>
+
+namespace ucb
+{
+    ThreadPool::ThreadPool(unsigned workers)
+    {
+        assert(workers > 0 && "a pool needs at least one worker");
+
+        for (unsigned i = 0; i < workers; ++i)
+        {
+            _queues.push_back(std::make_unique<WorkQueue>());
+        }
+
+        // worker 0 is whoever calls parallel_for
+        for (unsigned i = 1; i < workers; ++i)
+        {
+            _threads.emplace_back(&ThreadPool::_worker, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+
+        _start_cv.notify_all();
+
+        for (auto& t: _threads)
+        {
+            t.join();
+        }
+    }
+
+    void ThreadPool::parallel_for(std::size_t n, const std::function<void(std::size_t)>& f)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        if (_threads.empty())
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                f(i);
+            }
+
+            return;
+        }
+
+        auto workers = _queues.size();
+
+        for (std::size_t w = 0; w < workers; ++w)
+        {
+            auto& q = *_queues[w];
+            std::lock_guard lock(q.mutex);
+
+            for (auto i = w * n / workers; i < (w + 1) * n / workers; ++i)
+            {
+                q.items.push_back(i);
+            }
+        }
+
+        {
+            std::lock_guard lock(_mutex);
+            _job = &f;
+            _busy = _threads.size();
+            ++_generation;
+        }
+
+        _start_cv.notify_all();
+        _run(0);
+
+        std::unique_lock lock(_mutex);
+        _done_cv.wait(lock, [&] { return _busy == 0; });
+        _job = nullptr;
+    }
+
+    void ThreadPool::_worker(unsigned idx)
+    {
+        std::uint64_t seen = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock lock(_mutex);
+                _start_cv.wait(lock, [&] { return _stop || _generation != seen; });
+
+                if (_stop)
+                {
+                    return;
+                }
+
+                seen = _generation;
+            }
+
+            _run(idx);
+
+            std::lock_guard lock(_mutex);
+
+            if (--_busy == 0)
+            {
+                _done_cv.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::_run(unsigned idx)
+    {
+        std::size_t item;
+
+        while (_pop(idx, item))
+        {
+            (*_job)(item);
+        }
+    }
+
+    bool ThreadPool::_pop(unsigned idx, std::size_t& item)
+    {
+        {
+            auto& own = *_queues[idx];
+            std::lock_guard lock(own.mutex);
+
+            if (!own.items.empty())
+            {
+                item = own.items.front();
+                own.items.pop_front();
+                return true;
+            }
+        }
+
+        // steal from the back so the victim keeps walking its slice in order
+        for (std::size_t i = 1; i < _queues.size(); ++i)
+        {
+            auto& victim = *_queues[(idx + i) % _queues.size()];
+            std::lock_guard lock(victim.mutex);
+
+            if (!victim.items.empty())
+            {
+                item = victim.items.back();
+                victim.items.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ucb
+{
+    // fixed set of workers that run index ranges in parallel. every worker
+    // starts with a contiguous slice of the range on its own queue and steals
+    // from the other end of its neighbours' queues once it runs dry
+    class ThreadPool
+    {
+    public:
+        // the calling thread counts as one of the workers
+        explicit ThreadPool(unsigned workers);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator = (const ThreadPool&) = delete;
+
+        unsigned size() const { return _queues.size(); }
+
+        // runs f(i) for every i in [0, n) and returns once all of them are
+        // done, f must be safe to call concurrently for different indices
+        void parallel_for(std::size_t n, const std::function<void(std::size_t)>& f);
+
+    private:
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<std::size_t> items;
+        };
+
+        std::vector<std::thread> _threads;
+        std::vector<std::unique_ptr<WorkQueue>> _queues;
+
+        std::mutex _mutex;
+        std::condition_variable _start_cv;
+        std::condition_variable _done_cv;
+        const std::function<void(std::size_t)> *_job{nullptr};
+        std::uint64_t _generation{0};
+        unsigned _busy{0};
+        bool _stop{false};
+
+        void _worker(unsigned idx);
+        void _run(unsigned idx);
+        bool _pop(unsigned idx, std::size_t& item);
+    };
+}
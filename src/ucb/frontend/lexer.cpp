@@ -1,27 +1,49 @@
 #include <ucb/frontend/lexer.hpp>
 
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 #include <unordered_map>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <fmt/core.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define UCB_LEXER_SIMD
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define UCB_LEXER_SIMD
+#endif
+
 #define DEBUG(T, ...) \
     if (_print_debug) { fmt::print(stderr, "Lexer: " T __VA_OPT__(,) __VA_ARGS__); }
 
 #define DEBUG_LOC(T, ...) \
-    if (_print_debug) { fmt::print(stderr, "Lexer: {}:{}:{} " T, _filename, _row, _col __VA_OPT__(,) __VA_ARGS__); }
+    if (_print_debug) \
+    { \
+        auto loc = location(_head_cursor - _src.data()); \
+        fmt::print(stderr, "Lexer: {}:{}:{} " T, _filename, loc.row, loc.col __VA_OPT__(,) __VA_ARGS__); \
+    }
 
 #define ERROR(T, ...) \
     { \
         fmt::print(stderr, "Lexer Error: " T __VA_OPT__(,) __VA_ARGS__); \
-        fmt::print(stderr, "\t cursor at {}:{}:{}", _filename, _head_row, _head_col); \
+        auto loc = location(_head_cursor - _src.data()); \
+        fmt::print(stderr, "\t cursor at {}:{}:{}", _filename, loc.row, loc.col); \
         abort(); \
     }
 
 namespace ucb::frontend
 {
-    static std::unordered_map<std::string, TokenType> KEYWORD_TBL = {{
+    static std::unordered_map<std::string_view, TokenType> KEYWORD_TBL = {{
         {"add", TokenType::OP_ADD},
         {"sub", TokenType::OP_SUB},
         {"mul", TokenType::OP_MUL},
@@ -90,26 +112,208 @@ namespace ucb::frontend
             || c == ')';
     }
 
-    Lexer::Lexer(std::string filename, bool print_debug):
+    enum ScanClass
+    {
+        SC_WHITESPACE,
+        // whitespace or an op, anything else continues an identifier
+        SC_ID_END,
+        SC_NEWLINE
+    };
+
+    template<ScanClass C>
+    inline bool in_class(char c)
+    {
+        switch (C)
+        {
+            case SC_WHITESPACE: return is_whitespace(c);
+            case SC_ID_END: return is_whitespace(c) || is_op(c);
+            case SC_NEWLINE: return c == '\n';
+        }
+
+        return false;
+    }
+
+#if defined(UCB_LEXER_SIMD)
+#if defined(__AVX2__)
+    constexpr std::ptrdiff_t SIMD_WIDTH = 32;
+    using SimdBlock = __m256i;
+
+    inline SimdBlock simd_load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    inline SimdBlock simd_eq(SimdBlock v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+    inline SimdBlock simd_or(SimdBlock a, SimdBlock b) { return _mm256_or_si256(a, b); }
+    inline std::uint32_t simd_mask(SimdBlock v) { return _mm256_movemask_epi8(v); }
+#else
+    constexpr std::ptrdiff_t SIMD_WIDTH = 16;
+    using SimdBlock = __m128i;
+
+    inline SimdBlock simd_load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    inline SimdBlock simd_eq(SimdBlock v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+    inline SimdBlock simd_or(SimdBlock a, SimdBlock b) { return _mm_or_si128(a, b); }
+    inline std::uint32_t simd_mask(SimdBlock v) { return _mm_movemask_epi8(v); }
+#endif
+
+    // bit i is set when p[i] is in the class
+    template<ScanClass C>
+    inline std::uint32_t block_mask(const char *p)
+    {
+        auto v = simd_load(p);
+
+        if (C == SC_NEWLINE)
+        {
+            return simd_mask(simd_eq(v, '\n'));
+        }
+
+        auto ws = simd_or(simd_or(simd_eq(v, ' '), simd_eq(v, '\t')), simd_or(simd_eq(v, '\n'), simd_eq(v, '\r')));
+
+        if (C == SC_WHITESPACE)
+        {
+            return simd_mask(ws);
+        }
+
+        auto op = simd_or(simd_or(simd_eq(v, '^'), simd_eq(v, '{')), simd_or(simd_eq(v, '}'), simd_eq(v, ',')));
+        op = simd_or(op, simd_or(simd_or(simd_eq(v, '='), simd_eq(v, ';')), simd_or(simd_eq(v, ':'), simd_eq(v, '('))));
+        op = simd_or(op, simd_eq(v, ')'));
+
+        return simd_mask(simd_or(ws, op));
+    }
+#endif
+
+    // first char in [p, end) that is (or is not, when member is false) in
+    // the class. whole blocks are classified at once while they fit, the
+    // tail goes char by char so nothing past end is ever read
+    template<ScanClass C>
+    inline const char* scan(const char *p, const char *end, bool member)
+    {
+#if defined(UCB_LEXER_SIMD)
+        constexpr auto all = static_cast<std::uint32_t>((std::uint64_t{1} << SIMD_WIDTH) - 1);
+
+        for (; end - p >= SIMD_WIDTH; p += SIMD_WIDTH)
+        {
+            auto mask = block_mask<C>(p);
+
+            if (!member)
+            {
+                mask = ~mask & all;
+            }
+
+            if (mask != 0)
+            {
+                return p + std::countr_zero(mask);
+            }
+        }
+#endif
+
+        while (p != end && in_class<C>(*p) != member)
+        {
+            ++p;
+        }
+
+        return p;
+    }
+
+    Lexer::Lexer(std::string filename, SymbolTable& symbols, bool print_debug):
+        _filename(std::move(filename)),
+        _symbols(&symbols),
+        _print_debug(print_debug)
+    {
+        if (_filename == "-")
+        {
+            _open(STDIN_FILENO);
+        }
+        else
+        {
+            auto fd = ::open(_filename.c_str(), O_RDONLY);
+
+            if (fd == -1)
+            {
+                std::cerr << "could not open source file\"" << _filename << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            _open(fd);
+            ::close(fd);
+        }
+
+        _start(0, _src.size());
+    }
+
+    Lexer::Lexer(std::string filename, std::string_view src, SymbolTable& symbols, bool print_debug):
+        _filename(std::move(filename)),
+        _symbols(&symbols),
+        _src(src),
+        _print_debug(print_debug)
+    {
+        _start(0, _src.size());
+    }
+
+    Lexer::Lexer(std::string filename, std::string_view src, std::size_t begin, std::size_t end, SymbolTable& symbols, bool print_debug):
         _filename(std::move(filename)),
+        _symbols(&symbols),
+        _src(src),
         _print_debug(print_debug)
     {
-        std::ifstream ifs(_filename);
+        _start(begin, end);
+    }
+
+    Lexer::~Lexer()
+    {
+        if (_map != nullptr)
+        {
+            munmap(_map, _map_size);
+        }
+    }
+
+    void Lexer::_open(int fd)
+    {
+        struct stat st;
+
+        // regular files are mapped, the tokens then point straight into the
+        // page cache instead of a copy of the file
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            auto map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (map != MAP_FAILED)
+            {
+                madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+                _map = map;
+                _map_size = st.st_size;
+                _src = std::string_view(static_cast<const char*>(map), _map_size);
+                return;
+            }
+        }
 
-        if (!ifs.is_open())
+        // pipes can't be mapped, they are read in blocks until the end
+        char block[1 << 16];
+
+        while (true)
         {
-            std::cerr << "could not open source file\"" << _filename << std::endl;
-            exit(EXIT_FAILURE);
+            auto n = ::read(fd, block, sizeof(block));
+
+            if (n > 0)
+            {
+                _buf.append(block, n);
+            }
+            else if (n == 0)
+            {
+                break;
+            }
+            else if (errno != EINTR)
+            {
+                std::cerr << "could not read source file\"" << _filename << "\": " << std::strerror(errno) << std::endl;
+                exit(EXIT_FAILURE);
+            }
         }
 
-        _src = std::string((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+        _src = _buf;
+    }
 
-        _cursor      = _src.begin();
-        _head_cursor = _src.begin();
-        _col         = 1;
-        _head_col    = 1;
-        _row         = 1;
-        _head_row    = 1;
+    void Lexer::_start(std::size_t begin, std::size_t end)
+    {
+        _cursor      = _src.data() + begin;
+        _head_cursor = _src.data() + begin;
+        _end         = _src.data() + end;
 
         _current = _read_token();
     }
@@ -133,15 +337,24 @@ namespace ucb::frontend
 
     Token Lexer::_read_token()
     {
-        while (_cursor != _src.end())
+        while (_cursor != _end)
         {
             auto c = *_cursor;
 
+            // whitespace and comments never reach the parser, runs of them
+            // are skipped here in bulk
             if (is_whitespace(c))
-                return _read_whitespace_tk();
+            {
+                _cursor = scan<SC_WHITESPACE>(_cursor, _end, false);
+                _head_cursor = _cursor;
+                continue;
+            }
 
             if (c == ';')
-                return _read_comment_ln_tk();
+            {
+                _skip_comment_ln();
+                continue;
+            }
 
             if (c == '"')
                 return _read_str_tk();
@@ -187,72 +400,33 @@ namespace ucb::frontend
 
         return {
             .ty = TokenType::END_OF_FILE,
-            .row = _row,
-            .col = _col
+            .pos = static_cast<std::size_t>(_cursor - _src.data())
         };
     }
 
-    Token Lexer::_read_whitespace_tk()
+    void Lexer::_skip_comment_ln()
     {
-        DEBUG("Reading whitespace token\n");
+        auto nl = scan<SC_NEWLINE>(_cursor, _end, true);
 
-        while (_cursor != _src.end())
+        if (nl == _end)
         {
-            auto c = *_cursor;
-
-            if (!is_whitespace(c))
-            {
-                break;
-            }
-
-            _cursor++;
-            _col++;
-
-            if (c == '\n')
-            {
-                _row++;
-                _col = 1;
-            }
+            _head_cursor = _cursor;
+            ERROR("expected new line but found end of file");
         }
 
-        DEBUG_LOC("read whitespace token\n");
-        return _build_tk(TokenType::WHITESPACE);
-    }
-
-    Token Lexer::_read_comment_ln_tk()
-    {
-        DEBUG("Reading comment line token\n");
-
-        while (_cursor != _src.end())
-        {
-            auto c = *_cursor;
-
-            _cursor++;
-            _col++;
-
-            if (c == '\n')
-            {
-                _row++;
-                _col = 1;
-
-                return _build_tk(TokenType::COMMENT_LINE);
-            }
-        }
-
-        DEBUG_LOC("read comment line token with lexema '{}'\n", _build_lexema());
-        ERROR("expected new line but found end of file");
+        _cursor = nl + 1;
+        _head_cursor = _cursor;
     }
 
     Token Lexer::_read_str_tk()
     {
         DEBUG("Reading string literal token\n");
 
-        while (_cursor != _src.end())
+        while (_cursor != _end)
         {
             auto c = *_cursor;
 
             _cursor++;
-            _col++;
 
             if (c == '"')
                 return _build_tk(TokenType::LT_STRING);
@@ -266,24 +440,20 @@ namespace ucb::frontend
     {
         DEBUG("Reading numeric token\n");
 
-        while (_cursor != _src.end())
+        while (_cursor != _end)
         {
             auto c = *_cursor;
 
             _cursor++;
-            _col++;
 
             if (c == '.')
             {
-                while (_cursor != _src.end())
+                while (_cursor != _end)
                 {
                     _cursor++;
-                    _col++;
-
-                    auto d = *_cursor;
-
 
-                    if (d < '0' || d > '9')
+                    // the mapping ends right after the last byte
+                    if (_cursor == _end || *_cursor < '0' || *_cursor > '9')
                     {
                         DEBUG_LOC("read floating point literal with lexema '{}'\n", _build_lexema());
                         return _build_tk(TokenType::LT_FLOAT);
@@ -299,46 +469,82 @@ namespace ucb::frontend
         return _build_tk(TokenType::LT_INT);
     }
 
-    std::string Lexer::_eat_id(int skip_cnt)
+    std::string_view Lexer::_eat_id(int skip_cnt)
     {
         auto start = _cursor + skip_cnt;
 
-        while (_cursor != _src.end())
-        {
-
-            _cursor++;
-            _col++;
-            auto c = *_cursor;
-
-            if (is_whitespace(c) || is_op(c))
-                break;
-        }
+        // the first char is part of the id whatever it is
+        _cursor = scan<SC_ID_END>(_cursor + 1, _end, true);
 
-        return std::string(start, _cursor/* - 1*/);
+        return std::string_view(start, _cursor - start);
     }
 
     std::string_view Lexer::_build_lexema(int skip_cnt)
     {
-        return std::string_view(_head_cursor + skip_cnt, _cursor/* - 1*/);
+        return std::string_view(_head_cursor + skip_cnt, _cursor - _head_cursor - skip_cnt);
     }
 
     Token Lexer::_build_tk(TokenType ty, int skip_cnt)
     {
-        auto row = _head_row;
-        auto col = _head_col;
-        std::string_view lex(_head_cursor + skip_cnt, _cursor/* - 1*/);
+        auto pos = static_cast<std::size_t>(_head_cursor - _src.data());
+        std::string_view lex(_head_cursor + skip_cnt, _cursor - _head_cursor - skip_cnt);
 
-        _head_row = _row;
-        _head_col = _col;
         _head_cursor = _cursor;
-        // _head_cursor = _cursor - 1;
-        // _cursor = _cursor - 1;
+
+        auto is_id = ty == TokenType::ID_LOCAL
+            || ty == TokenType::ID_GLOBAL
+            || ty == TokenType::ID_OTHER;
 
         return {
             .ty     = ty,
-            .row    = row,
-            .col    = col,
-            .lexema = lex
+            .pos    = pos,
+            .lexema = lex,
+            .sym    = is_id ? _symbols->intern(lex) : NO_SYMBOL
+        };
+    }
+
+    SourceLoc Lexer::location(std::size_t pos)
+    {
+        if (_line_starts.empty())
+        {
+            _index_lines();
+        }
+
+        auto it = std::upper_bound(_line_starts.begin(), _line_starts.end(), pos);
+        auto row = it - _line_starts.begin();
+
+        return {
+            .row = row,
+            .col = static_cast<long>(pos - *(it - 1)) + 1
         };
     }
+
+    void Lexer::_index_lines()
+    {
+        // lines are counted from the start of the source even when only a
+        // range of it is lexed
+        auto begin = _src.data();
+        auto end = _src.data() + _src.size();
+        auto p = begin;
+
+        _line_starts.push_back(0);
+
+#if defined(UCB_LEXER_SIMD)
+        for (; end - p >= SIMD_WIDTH; p += SIMD_WIDTH)
+        {
+            for (auto mask = block_mask<SC_NEWLINE>(p); mask != 0; mask &= mask - 1)
+            {
+                _line_starts.push_back(p - begin + std::countr_zero(mask) + 1);
+            }
+        }
+#endif
+
+        for (; p != end; ++p)
+        {
+            if (*p == '\n')
+            {
+                _line_starts.push_back(p - begin + 1);
+            }
+        }
+    }
 }
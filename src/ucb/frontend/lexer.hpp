@@ -3,7 +3,10 @@
 #include <ucb/core/config.hpp>
 #include <ucb/frontend/token.hpp>
 
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <iostream>
 
 namespace ucb::frontend
@@ -11,32 +14,58 @@ namespace ucb::frontend
     class Lexer
     {
     public:
-        Lexer(std::string filename, bool print_debug);
+        // the file is mapped into memory, "-" reads the whole of stdin.
+        // identifiers are interned into symbols as they are read
+        Lexer(std::string filename, SymbolTable& symbols, bool print_debug);
+        // lexes a buffer owned by the caller, filename is only used in
+        // messages. the buffer must outlive the tokens
+        Lexer(std::string filename, std::string_view src, SymbolTable& symbols, bool print_debug);
+        // lexes only src[begin, end), positions and locations are still
+        // those in the whole of src
+        Lexer(std::string filename, std::string_view src, std::size_t begin, std::size_t end, SymbolTable& symbols, bool print_debug);
+        ~Lexer();
+
+        // tokens point into the mapping
+        Lexer(const Lexer&) = delete;
+        Lexer& operator = (const Lexer&) = delete;
 
         Token bump();
         Token peek();
         bool is_eof();
 
+        std::string_view source() const { return _src; }
+
+        // row and column of a byte offset, the newline index behind it is
+        // only built the first time a diagnostic asks for one
+        SourceLoc location(std::size_t pos);
+        SourceLoc location(const Token& tk) { return location(tk.pos); }
+
     private:
         std::string _filename;
-        std::string _src;
+        SymbolTable *_symbols;
+        std::string_view _src;
+        // backs _src when reading from a pipe
+        std::string _buf;
+        void *_map{nullptr};
+        std::size_t _map_size{0};
         bool _print_debug;
 
-        std::string::iterator _cursor;
-        std::string::iterator _head_cursor;
-        long _row;
-        long _head_row;
-        long _col;
-        long _head_col;
+        const char *_cursor;
+        const char *_head_cursor;
+        const char *_end;
+        // offset of the first char of each line
+        std::vector<std::size_t> _line_starts;
 
         Token _current;
 
+        void _open(int fd);
+        void _start(std::size_t begin, std::size_t end);
+        void _index_lines();
         Token _read_token();
-        Token _read_whitespace_tk();
-        Token _read_comment_ln_tk();
+        void _skip_comment_ln();
         Token _read_str_tk();
         Token _read_numeric_tk();
-        std::string _eat_id(int skip_cnt);
+        std::string_view _eat_id(int skip_cnt);
 
         std::string_view _build_lexema(int skip_cnt = 0);
         Token _build_tk(TokenType ty, int skip_cnt = 0);
@@ -1,6 +1,7 @@
 #include <ucb/frontend/parser.hpp>
 
 #include <algorithm>
+#include <array>
 #include <string>
 #include <vector>
 
@@ -10,11 +11,16 @@
     if (_debug) { fmt::print(stderr, "Parser: " T __VA_OPT__(,) __VA_ARGS__); }
 
 #define DEBUG_LOC(T, TK, ...) \
-    if (_debug) { fmt::print(stderr, "Parser: {}:{}:{} " T, _filename, TK.row, TK.col __VA_OPT__(,) __VA_ARGS__); }
+    if (_debug) \
+    { \
+        auto loc = _lex.location(TK); \
+        fmt::print(stderr, "Parser: {}:{}:{} " T, _filename, loc.row, loc.col __VA_OPT__(,) __VA_ARGS__); \
+    }
 
 #define ERROR(T, TK, ...) \
     { \
-        fmt::print(stderr, "\t Parser error at {}:{}:{}: " T, _filename, TK.row, TK.col __VA_OPT__(,) __VA_ARGS__); \
+        auto loc = _lex.location(TK); \
+        fmt::print(stderr, "\t Parser error at {}:{}:{}: " T, _filename, loc.row, loc.col __VA_OPT__(,) __VA_ARGS__); \
         return false; \
     }
 
@@ -28,8 +34,56 @@
 
 namespace ucb::frontend
 {
-    bool Parser::parse_unit()
+    // [begin, end) ranges of src that each end right after the closing brace
+    // of a top level definition, anything after the last one (globals,
+    // comments) is a range of its own. only comments and strings need to be
+    // told apart to find the braces, the pieces are checked when parsed
+    static std::vector<std::pair<std::size_t, std::size_t>> split_unit(std::string_view src)
+    {
+        std::vector<std::pair<std::size_t, std::size_t>> res;
+        std::size_t begin = 0;
+        int depth = 0;
+
+        for (auto i = src.find_first_of("{};\""); i != std::string_view::npos; i = src.find_first_of("{};\"", i + 1))
+        {
+            auto c = src[i];
+
+            if (c == ';' || c == '"')
+            {
+                i = src.find(c == ';' ? '\n' : '"', i + 1);
+
+                if (i == std::string_view::npos)
+                {
+                    break;
+                }
+            }
+            else if (c == '{')
+            {
+                ++depth;
+            }
+            else if (depth > 0 && --depth == 0)
+            {
+                res.emplace_back(begin, i + 1);
+                begin = i + 1;
+            }
+        }
+
+        if (src.find_first_not_of(" \t\r\n", begin) != std::string_view::npos)
+        {
+            res.emplace_back(begin, src.size());
+        }
+
+        return res;
+    }
+
+    bool Parser::parse_unit(ThreadPool *pool)
     {
+        // debug output of concurrent parsers would be interleaved
+        if (pool != nullptr && pool->size() > 1 && !_debug && !_debug_lexer)
+        {
+            return _parse_unit_parallel(*pool);
+        }
+
         // load the first token
         _bump();
 
@@ -44,6 +98,46 @@ namespace ucb::frontend
         return true;
     }
 
+    bool Parser::stream_unit(ProcSink sink)
+    {
+        _sink = std::move(sink);
+        return parse_unit();
+    }
+
+    bool Parser::_parse_unit_parallel(ThreadPool& pool)
+    {
+        auto ranges = split_unit(_lex.source());
+        std::vector<std::vector<std::shared_ptr<Procedure>>> parsed(ranges.size());
+        // not a vector<bool>, the workers write next to each other
+        std::vector<char> ok(ranges.size(), false);
+
+        pool.parallel_for(ranges.size(), [&](std::size_t i)
+        {
+            auto sink = [&procs = parsed[i]](std::shared_ptr<Procedure> proc)
+            {
+                procs.push_back(std::move(proc));
+            };
+
+            Parser parser(_filename, _lex.source(), ranges[i].first, ranges[i].second, _compile_unit, sink);
+            ok[i] = parser.parse_unit();
+        });
+
+        if (std::find(ok.begin(), ok.end(), false) != ok.end())
+        {
+            return false;
+        }
+
+        for (auto& procs: parsed)
+        {
+            for (auto& proc: procs)
+            {
+                _compile_unit->add_procedure(std::move(proc));
+            }
+        }
+
+        return true;
+    }
+
     bool Parser::_parse_def()
     {
         TypeID ty;
@@ -59,7 +153,7 @@ namespace ucb::frontend
 
         if (next.ty == '(')
         {
-            return _parse_func(ty, std::string(id.lexema));
+            return _parse_func(ty, id.sym);
         }
         else if (next.ty == '=')
         {
@@ -87,7 +181,7 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_func(TypeID ret_ty, std::string id)
+    bool Parser::_parse_func(TypeID ret_ty, SymbolID id)
     {
         auto lp = _cur;
         CHECK_TK(lp, lp.ty == '(', "'('");
@@ -99,8 +193,16 @@ namespace ucb::frontend
             return false;
         }
 
-        _proc = _compile_unit->add_procedure(sig, id);
-        auto idx = _proc->add_bblock("entry");
+        if (_sink)
+        {
+            _proc = std::make_shared<Procedure>(_compile_unit.get(), id, std::move(sig));
+        }
+        else
+        {
+            _proc = _compile_unit->add_procedure(sig, id);
+        }
+
+        auto idx = _proc->add_bblock(_compile_unit->symbols().intern("entry"));
         _bblock = _proc->get_bblock(idx);
 
         auto lb = _cur;
@@ -118,6 +220,11 @@ namespace ucb::frontend
             }
         }
 
+        if (_sink)
+        {
+            _sink(std::move(_proc));
+        }
+
         _proc = nullptr;
         _bblock = nullptr;
         _bump();
@@ -137,7 +244,7 @@ namespace ucb::frontend
             auto id = _cur;
             CHECK_TK(id, id.ty == TokenType::ID_LOCAL, "local identifier");
 
-            sig.args().emplace_back(id.lexema, ty);
+            sig.args().emplace_back(id.sym, ty);
 
             auto c = _bump();
 
@@ -191,11 +298,11 @@ namespace ucb::frontend
         auto p = _bump();
         CHECK_TK(p, p.ty == ':', "':'");
 
-        auto idx = _proc->find_bblock(std::string(id.lexema));
+        auto idx = _proc->find_bblock(id.sym);
 
         if (idx == -1)
         {
-            idx = _proc->add_bblock(std::string(id.lexema));
+            idx = _proc->add_bblock(id.sym);
         }
 
         _bblock = _proc->get_bblock(idx);
@@ -221,31 +328,31 @@ namespace ucb::frontend
 
         if (tk_is_bin_op(op))
         {
-            return _parse_bin_op(std::string(def_id.lexema));
+            return _parse_bin_op(def_id.sym);
         }
         else if (op.ty == TokenType::OP_NOT || op.ty == TokenType::OP_CP)
         {
-            return _parse_unnary_op(std::string(def_id.lexema));
+            return _parse_unnary_op(def_id.sym);
         }
         else if (op.ty == TokenType::OP_CAST)
         {
-            return _parse_cast(std::string(def_id.lexema));
+            return _parse_cast(def_id.sym);
         }
         else if (op.ty == TokenType::OP_ALLOC)
         {
-            return _parse_alloc(std::string(def_id.lexema));
+            return _parse_alloc(def_id.sym);
         }
         else if (op.ty == TokenType::OP_LOAD)
         {
-            return _parse_load(std::string(def_id.lexema));
+            return _parse_load(def_id.sym);
         }
         else if (op.ty == TokenType::OP_CALL)
         {
-            return _parse_call(std::string(def_id.lexema));
+            return _parse_call(def_id.sym);
         }
         else if (op.ty == TokenType::OP_CMP)
         {
-            return _parse_cmp(std::string(def_id.lexema));
+            return _parse_cmp(def_id.sym);
         }
 
         ERROR("expected an asignment statement but found '{}'", op, op.lexema);
@@ -368,7 +475,7 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_bin_op(std::string def_id)
+    bool Parser::_parse_bin_op(SymbolID def_id)
     {
         auto optk = _cur;
         CHECK_TK(optk, tk_is_bin_op(optk), "a binary operation");
@@ -460,7 +567,7 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_unnary_op(std::string def_id)
+    bool Parser::_parse_unnary_op(SymbolID def_id)
     {
         auto op = _cur;
         CHECK_TK(op,op.ty == TokenType::OP_NOT || op.ty == TokenType::OP_CP, "an unnary op");
@@ -499,7 +606,7 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_cast(std::string def_id)
+    bool Parser::_parse_cast(SymbolID def_id)
     {
         CHECK_TK(_cur, _cur.ty ==TokenType::OP_CAST, "cast");
 
@@ -539,7 +646,7 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_alloc(std::string def_id)
+    bool Parser::_parse_alloc(SymbolID def_id)
     {
         CHECK_TK(_cur, _cur.ty == TokenType::OP_ALLOC, "alloc");
 
@@ -556,7 +663,7 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_load(std::string def_id)
+    bool Parser::_parse_load(SymbolID def_id)
     {
         CHECK_TK(_cur, _cur.ty == TokenType::OP_LOAD, "load");
 
@@ -596,7 +703,7 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_call(std::string def_id)
+    bool Parser::_parse_call(SymbolID def_id)
     {
         CHECK_TK(_cur, _cur.ty == TokenType::OP_CALL, "call");
 
@@ -621,7 +728,7 @@ namespace ucb::frontend
         CHECK_TK(id, id.ty == TokenType::ID_GLOBAL, "a global identifier");
         auto lp = _bump();
 
-        auto& inst = _bblock->append_instr(InstrOpcode::OP_CALL, ty, std::string(id.lexema));
+        auto& inst = _bblock->append_instr(InstrOpcode::OP_CALL, ty, id.sym);
         inst.add_operand(def);
 
         CHECK_TK(lp, lp.ty == '(', "'('");
@@ -653,12 +760,12 @@ namespace ucb::frontend
         return true;
     }
 
-    bool Parser::_parse_cmp(std::string def_id)
+    bool Parser::_parse_cmp(SymbolID def_id)
     {
         CHECK_TK(_cur, _cur.ty == TokenType::OP_CMP, "cmp");
 
         auto mode = _bump();
-        std::vector<std::string> modes = {"eq", "ne", "lt", "le", "gt", "ge"};
+        constexpr std::array<std::string_view, 6> modes = {"eq", "ne", "lt", "le", "gt", "ge"};
         CHECK_TK(mode, mode.ty == TokenType::ID_OTHER && std::find(modes.begin(), modes.end(), mode.lexema) != modes.end(), "a comparison mode");
 
         _bump();
@@ -691,7 +798,7 @@ namespace ucb::frontend
         }
 
         // TODO the mode should be separated, but i cant be bothered
-        auto& inst = _bblock->append_instr(InstrOpcode::OP_CMP, T_BOOL, std::string(mode.lexema));
+        auto& inst = _bblock->append_instr(InstrOpcode::OP_CMP, T_BOOL, mode.sym);
         inst.add_operand(def);
         inst.add_operand(lhs);
         inst.add_operand(rhs);
@@ -803,7 +910,7 @@ namespace ucb::frontend
         {
             if (ty == T_STATIC_ADDRESS)
             {
-                auto lex = std::string(_cur.lexema);
+                auto lex = _cur.sym;
 
                 if (_proc->find_bblock(lex) == -1)
                 {
@@ -814,7 +921,7 @@ namespace ucb::frontend
             }
             else
             {
-                op = _proc->operand_from_vreg(std::string(_cur.lexema), is_def);
+                op = _proc->operand_from_vreg(_cur.sym, is_def);
 
                 if (op == Operand())
                 {
@@ -831,12 +938,12 @@ namespace ucb::frontend
             if (ty_is_signed_int(ty))
             {
                 auto val = std::stol(std::string(_cur.lexema));
-                op = Operand(_proc.get(), val, ty);
+                op = Operand(val, ty);
             }
             else if (ty_is_unsigned_int(ty))
             {
                 auto val = std::stoul(std::string(_cur.lexema));
-                op = Operand(_proc.get(), val, ty);
+                op = Operand(val, ty);
             }
             else
             {
@@ -855,7 +962,7 @@ namespace ucb::frontend
             }
 
             auto val = std::stod(std::string(_cur.lexema));
-            op = Operand(_proc.get(), val, ty);
+            op = Operand(val, ty);
 
             _bump();
             return true;
@@ -3,7 +3,9 @@
 #include <ucb/core/config.hpp>
 
 #include <memory>
+#include <vector>
 
+#include <ucb/core/thread-pool.hpp>
 #include <ucb/core/ir/compile-unit.hpp>
 #include <ucb/core/ir/instruction.hpp>
 #include <ucb/core/ir/type.hpp>
@@ -19,12 +21,31 @@ namespace ucb::frontend
             _compile_unit(compile_unit),
             _proc{nullptr},
             _bblock{nullptr},
-            _lex(_filename, debug_lexer),
+            _lex(_filename, compile_unit->symbols(), debug_lexer),
+            _debug_lexer(debug_lexer),
             _debug(debug_parser)
         {
         }
 
-        bool parse_unit();
+        // parses a buffer owned by the caller, see Lexer
+        Parser(std::string filename, std::string_view src, std::shared_ptr<CompileUnit> compile_unit, bool debug_lexer, bool debug_parser):
+            _filename(std::move(filename)),
+            _compile_unit(compile_unit),
+            _proc{nullptr},
+            _bblock{nullptr},
+            _lex(_filename, src, compile_unit->symbols(), debug_lexer),
+            _debug_lexer(debug_lexer),
+            _debug(debug_parser)
+        {
+        }
+
+        // with a pool the source is split at the top level definitions and
+        // the pieces are parsed concurrently, the procedures still end up in
+        // the unit in source order
+        bool parse_unit(ThreadPool *pool = nullptr);
+        // hands each procedure to sink once its closing brace is parsed
+        // instead of adding it to the unit
+        bool stream_unit(ProcSink sink);
 
     private:
         std::string _filename;
@@ -33,11 +54,30 @@ namespace ucb::frontend
         BasicBlock *_bblock;
         Lexer _lex;
         Token _cur;
+        bool _debug_lexer;
         bool _debug;
+        // procedures go here instead of the unit when set
+        ProcSink _sink;
+
+        // parses src[begin, end) into sink
+        Parser(std::string filename, std::string_view src, std::size_t begin, std::size_t end,
+            std::shared_ptr<CompileUnit> compile_unit, ProcSink sink):
+            _filename(std::move(filename)),
+            _compile_unit(compile_unit),
+            _proc{nullptr},
+            _bblock{nullptr},
+            _lex(_filename, src, begin, end, compile_unit->symbols(), false),
+            _debug_lexer(false),
+            _debug(false),
+            _sink(std::move(sink))
+        {
+        }
+
+        bool _parse_unit_parallel(ThreadPool& pool);
 
         bool _parse_def();
         bool _parse_global();
-        bool _parse_func(TypeID ret_ty, std::string id);
+        bool _parse_func(TypeID ret_ty, SymbolID id);
         bool _parse_param_defs(TypeID ret_ty, ProcSignature& sig);
         bool _parse_statement();
         bool _parse_label();
@@ -46,13 +86,13 @@ namespace ucb::frontend
         bool _parse_br();
         bool _parse_brc();
         bool _parse_ret();
-        bool _parse_bin_op(std::string def_id);
-        bool _parse_unnary_op(std::string def_id);
-        bool _parse_cast(std::string def_id);
-        bool _parse_alloc(std::string def_id);
-        bool _parse_load(std::string def_id);
-        bool _parse_call(std::string def_id);
-        bool _parse_cmp(std::string def_id);
+        bool _parse_bin_op(SymbolID def_id);
+        bool _parse_unnary_op(SymbolID def_id);
+        bool _parse_cast(SymbolID def_id);
+        bool _parse_alloc(SymbolID def_id);
+        bool _parse_load(SymbolID def_id);
+        bool _parse_call(SymbolID def_id);
+        bool _parse_cmp(SymbolID def_id);
 
         bool _parse_ty(TypeID& ty);
         bool _parse_opnd(Operand& op, TypeID ty, bool is_def);
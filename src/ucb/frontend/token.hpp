@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <string_view>
+
+#include <ucb/core/ir/symbol.hpp>
 
 namespace ucb::frontend
 {
@@ -74,9 +78,17 @@ namespace ucb::frontend
     struct Token
     {
         TokenType ty;
+        // byte offset in the source, see Lexer::location
+        std::size_t pos;
+        std::string_view lexema;
+        // interned lexema of identifiers, NO_SYMBOL for other tokens
+        SymbolID sym{NO_SYMBOL};
+    };
+
+    struct SourceLoc
+    {
         long row;
         long col;
-        std::string_view lexema;
     };
 
     constexpr bool tk_is_transient(Token tk)
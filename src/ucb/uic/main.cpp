@@ -2,11 +2,19 @@
 
 #include <fstream>
 #include <iostream>
+#include <thread>
 
 #include <ucb/core/pass-manager.hpp>
 #include <ucb/core/backend/x64.hpp>
+#include <ucb/core/ir/binary.hpp>
 #include <ucb/core/isel/dp-isel.hpp>
+#include <ucb/core/opt/const-fold.hpp>
+#include <ucb/core/opt/dce.hpp>
+#include <ucb/core/opt/gvn.hpp>
+#include <ucb/core/opt/mem2reg.hpp>
+#include <ucb/core/opt/out-of-ssa.hpp>
 #include <ucb/core/regalloc/graph-coloring.hpp>
+#include <ucb/core/regalloc/linear-scan.hpp>
 #include <ucb/frontend/lexer.hpp>
 #include <ucb/frontend/parser.hpp>
 
@@ -16,26 +24,53 @@ using namespace ucb;
 
 namespace po = boost::program_options;
 
-std::unique_ptr<PassManager> make_pass_manager()
+std::unique_ptr<PassManager> make_pass_manager(std::shared_ptr<ThreadPool> pool, const std::string& regalloc_kind, unsigned opt_level)
 {
     std::vector<std::unique_ptr<Pass>> passes;
-    auto target = std::make_shared<x64::X64Target>();
 
+    if (opt_level >= 1)
+    {
+        passes.push_back(std::make_unique<PromoteMemToReg>());
+        passes.push_back(std::make_unique<OutOfSSA>());
+        passes.push_back(std::make_unique<GlobalValueNumbering>());
+        passes.push_back(std::make_unique<ConstantFolding>());
+        passes.push_back(std::make_unique<DeadCodeElimination>());
+    }
+
+    auto target = std::make_shared<x64::X64Target>();
     auto isel = std::make_unique<DynamicISel>(target);
-    auto regalloc = std::make_unique<GraphColoringRegAlloc>(target);
-    auto target_machine = std::make_unique<TargetMachine>(TargetArch::ARCH_X64, std::move(isel), std::move(regalloc), target);
-    return std::make_unique<PassManager>(std::move(passes), std::move(target_machine));
+    std::unique_ptr<RegAlloc> regalloc;
+
+    if (regalloc_kind == "linear")
+    {
+        regalloc = std::make_unique<LinearScanRegAlloc>(target);
+    }
+    else
+    {
+        regalloc = std::make_unique<GraphColoringRegAlloc>(target);
+    }
+
+    auto target_machine = std::make_unique<TargetMachine>(TargetArch::ARCH_X64, std::move(isel), std::move(regalloc), target, pool);
+    return std::make_unique<PassManager>(std::move(passes), std::move(target_machine), std::move(pool));
 }
 
 int main(int argc, char **argv)
 {
     std::string input_file;
+    unsigned jobs = 1;
+    std::string regalloc;
+    unsigned opt_level = 0;
 
     po::options_description desc("UCB Intermediate Representaiton Compiler");
     desc.add_options()
         ("help,h", "print this message")
-        ("input-file", po::value<std::string>(&input_file)->required(), "file to be compiled")
+        ("input-file", po::value<std::string>(&input_file)->required(), "file to be compiled, - reads from stdin")
         ("output,o", "output file name")
+        ("jobs,j", po::value<unsigned>(&jobs)->default_value(1), "number of procedures parsed and compiled in parallel, 0 uses every core")
+        ("regalloc", po::value<std::string>(&regalloc)->default_value("graph"), "register allocator, either graph (coloring) or linear (scan)")
+        ("emit-bin", "write the parsed unit in binary form to a .uib file instead of compiling it")
+        ("stream", "compile and print each procedure of a text unit as soon as it is parsed, so only a few procedures are in memory at a time")
+        ("opt-level,O", po::value<unsigned>(&opt_level)->default_value(0), "optimization level, 1 promotes frame slots to registers and runs value numbering, constant folding and dead code elimination")
     ;
 
     po::positional_options_description p;
@@ -57,24 +92,85 @@ int main(int argc, char **argv)
     }
 
     po::notify(vm);
+
+    if (regalloc != "graph" && regalloc != "linear")
+    {
+        std::cout << "unknown register allocator " << regalloc << std::endl;
+        return EXIT_FAILURE;
+    }
+
     std::string src_fname = vm["input-file"].as<std::string>();
 
+    if (jobs == 0)
+    {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // shared by the parser and the pass manager
+    std::shared_ptr<ThreadPool> pool;
+
+    if (jobs > 1)
+    {
+        pool = std::make_shared<ThreadPool>(jobs);
+    }
+
     auto context = std::make_shared<CompileUnit>();
-    frontend::Parser parser(src_fname, context, false, false);
 
-    if (!parser.parse_unit())
+    // binary units are told apart from text by their magic
+    char magic[4] = {};
+
+    if (src_fname != "-")
     {
-        std::cerr << "parse failure!!!\n";
-        return EXIT_FAILURE;
+        std::ifstream probe(src_fname, std::ios::binary);
+        probe.read(magic, sizeof(magic));
+    }
+
+    auto is_bin = is_binary(std::string_view(magic, sizeof(magic)));
+    // streaming parses while compiling, further down
+    auto streaming = vm.count("stream") > 0 && vm.count("emit-bin") == 0 && !is_bin;
+
+    if (is_bin)
+    {
+        BinaryReader reader(context);
+
+        if (!reader.open(src_fname) || !reader.read_all())
+        {
+            std::cerr << "could not load binary unit " << src_fname << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else if (!streaming)
+    {
+        frontend::Parser parser(src_fname, context, false, false);
+
+        if (!parser.parse_unit(pool.get()))
+        {
+            std::cerr << "parse failure!!!\n";
+            return EXIT_FAILURE;
+        }
     }
 
     int start = src_fname.find_last_of('/') + 1;
     int end = src_fname.find_last_of('.');
+    std::string stem = src_fname == "-" ? "a" : src_fname.substr(start, end - start);
+
+    if (vm.count("emit-bin"))
+    {
+        std::ofstream bin_output(stem + ".uib", std::ios::binary);
+
+        if (!bin_output.is_open())
+        {
+            std::cerr << "could not open output file " << stem << ".uib" << std::endl;
+            abort();
+        }
+
+        write_binary(*context, bin_output);
+        return EXIT_SUCCESS;
+    }
 
     std::string output_fname =
-        vm.count("output") > 0 ?
-        vm["output"].as<std::string>() :
-        src_fname.substr(start, end - start) + ".s";
+        vm.count("output") > 0 ? vm["output"].as<std::string>() :
+        stem + ".s";
 
     std::ofstream output;
     output.open(output_fname);
@@ -85,8 +181,27 @@ int main(int argc, char **argv)
         abort();
     }
 
-    auto pm = make_pass_manager();
-    pm->apply(context, src_fname, output);
+    auto pm = make_pass_manager(pool, regalloc, opt_level);
+
+    if (streaming)
+    {
+        frontend::Parser parser(src_fname, context, false, false);
+
+        auto produce = [&](const ProcSink& sink)
+        {
+            return parser.stream_unit(sink);
+        };
+
+        if (!pm->stream(context, produce, src_fname, output))
+        {
+            std::cerr << "parse failure!!!\n";
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        pm->apply(context, src_fname, output);
+    }
 
     output.close();
 